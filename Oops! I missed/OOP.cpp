@@ -3,6 +3,38 @@
 # include <fstream>
 # include <ctime>   // For seeding randomness
 # include <vector>
+# include <map>
+# include <memory>
+# include <algorithm>
+# include <chrono>
+# include <atomic>
+# include <thread>
+# include <mutex>
+# include <condition_variable> // Wakes the voice and journal threads when there is work
+# include <iomanip>
+# include <cstring>
+# include <sstream>
+# include <utility> // index_sequence, for the animation clip tables
+# include <cstdio> // The score journal is synced through a FILE
+# include <cmath>
+# if defined(__AVX2__)
+#  include <immintrin.h> // Flight path kernels, 8 birds at a time
+#  define PATHS_AVX2
+# elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h> // Flight path kernels, 4 birds at a time
+#  define PATHS_SSE2
+# endif
+# ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h> // File mapping for the asset pack
+#  include <io.h> // _commit, to sync the score journal
+# else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+# endif
 # include "SFML/Graphics.hpp"
 # include "SFML/Audio.hpp"
 # include "SFML/Window.hpp"
@@ -10,935 +42,6630 @@
 using namespace std;
 using namespace sf;
 
-class Bird
+long long nanosecondsNow()
 {
-protected:
-    Texture birdTexture;
-    Sprite birdSprite;
-    Vector2u textureSize; // Total size of the texture
-    int frameWidth, frameHeight; // Dimensions of a single frame
-    int currentFrame; // Current frame index
-    int totalFrames; // Total number of frames in the sprite sheet
-    float frameDuration; // Time per frame (seconds)
-    Clock animationClock; // Clock for animation timing
-
-public:
-    Bird(const string& filePath, int columns, int rows, float duration)
-    {
-        // Load the texture
-        birdTexture.loadFromFile(filePath);
+    // Finer than sf::Clock, for timing phases that take well under a microsecond
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-        // Set up texture properties
-        textureSize = birdTexture.getSize();
-        frameWidth = textureSize.x / columns;
-        frameHeight = textureSize.y / rows;
-        totalFrames = (columns * rows) - 1;
-        frameDuration = duration;
+// One timed phase of one frame
+struct ProfileSample
+{
+    const char* name; // Phase name, always a string literal
+    long long start; // Nanoseconds since the profiler started
+    long long duration; // Nanoseconds
+    Uint32 frame; // Render frame under way when the sample was recorded
+    Uint32 thread; // Small number for the recording thread, 1 for the first thread that records
+};
 
-        // Set up the sprite
-        birdSprite.setTexture(birdTexture);
-        birdSprite.setTextureRect(IntRect(0, 0, frameWidth, frameHeight));
-        birdSprite.setScale(0.5f, 0.5f);
-        currentFrame = 0;
+// Collects phase timings into a fixed ring buffer without locks, plus the length of every recent frame
+class Profiler
+{
+    enum
+    {
+        SampleCapacity = 65536, // Oldest samples are overwritten once this many have been recorded
+        FrameCapacity = 1024, // Frames kept for percentiles
+        LatencyCapacity = 64 // Shots kept for the click to photon figure
+    };
+
+    // A ring slot. Its fields are relaxed atomics so a reader copying a slot that is being overwritten is not a data race,
+    // the stamp then tells it to throw the copy away.
+    struct SampleSlot
+    {
+        atomic<size_t> stamp; // Sample number + 1 once the slot is filled, 0 while it is being written
+        atomic<const char*> name;
+        atomic<long long> start;
+        atomic<long long> duration;
+        atomic<Uint32> frame;
+        atomic<Uint32> thread;
+    };
+
+    unique_ptr<SampleSlot[]> samples;
+    atomic<size_t> sampleCount; // Samples ever recorded, the next one goes to sampleCount % SampleCapacity
+    vector<float> frameTimes; // Frame lengths in milliseconds, frame f at f % FrameCapacity
+    atomic<Uint32> frame; // Number of the frame being recorded
+    vector<float> latencies; // Recent click to photon times in milliseconds
+    size_t latencyCount; // Latencies ever recorded
+    long long epoch; // Time the profiler started
+    long long frameStart;
+
+    static Uint32 getThreadNumber()
+    {
+        static atomic<Uint32> threadCount(0);
+        thread_local Uint32 number = threadCount.fetch_add(1, memory_order_relaxed) + 1;
+        return number;
     }
 
-    virtual void updateAnimation()
+public:
+    Profiler() : samples(new SampleSlot[SampleCapacity]), frameTimes(FrameCapacity, 0.0f), latencies(LatencyCapacity, 0.0f)
     {
-        // Update animation frame based on elapsed time
-        if (animationClock.getElapsedTime().asSeconds() > frameDuration)
+        for (size_t i = 0; i < SampleCapacity; i++)
         {
-            currentFrame = (currentFrame + 1) % totalFrames; // Cycle through frames
-            int frameX = (currentFrame % (textureSize.x / frameWidth)) * frameWidth;
-            int frameY = (currentFrame / (textureSize.x / frameWidth)) * frameHeight;
-            birdSprite.setTextureRect(IntRect(frameX, frameY, frameWidth, frameHeight));
-            animationClock.restart();
+            samples[i].stamp.store(0, memory_order_relaxed);
         }
+        latencyCount = 0;
+        sampleCount = 0;
+        frame = 0;
+        epoch = nanosecondsNow();
+        frameStart = 0;
     }
 
-    Sprite& getSprite() // Provide access to the sprite
+    void record(const char* name, long long start, long long end)
     {
-        return birdSprite;
+        // Claiming a slot is one atomic add, so any thread can record without waiting on another.
+        // The slot's stamp is cleared while it is filled and published after, so readers skip a half written sample.
+        size_t number = sampleCount.fetch_add(1, memory_order_relaxed);
+        SampleSlot& slot = samples[number % SampleCapacity];
+        slot.stamp.store(0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        slot.name.store(name, memory_order_relaxed);
+        slot.start.store(start - epoch, memory_order_relaxed);
+        slot.duration.store(end - start, memory_order_relaxed);
+        slot.frame.store(frame.load(memory_order_relaxed), memory_order_relaxed);
+        slot.thread.store(getThreadNumber(), memory_order_relaxed);
+        slot.stamp.store(number + 1, memory_order_release);
     }
 
-    void randomizeStart(const Vector2u& windowSize)
+    void beginFrame()
     {
-        // Randomly choose a vertical position
-        float startY = rand() % (windowSize.y / 3);
-        birdSprite.setPosition(-birdSprite.getGlobalBounds().width, startY); // Start just off the left
+        frameStart = nanosecondsNow();
     }
-};
-
-class WhiteBird : public Bird
-{
-public:
-    WhiteBird(const string& filePath, int columns, int rows, float duration) : Bird(filePath, columns, rows, duration) {}
-};
 
-class BlueBird : public Bird
-{
-public:
-    BlueBird(const string& filePath, int columns, int rows, float duration) : Bird(filePath, columns, rows, duration) {}
-};
+    void endFrame()
+    {
+        long long now = nanosecondsNow();
+        Uint32 current = frame.load(memory_order_relaxed);
+        frameTimes[current % FrameCapacity] = (now - frameStart) / 1e6f;
+        frame.store(current + 1, memory_order_relaxed);
+    }
 
-class TurboBird : public Bird
-{
-public:
-    TurboBird(const string& filePath, int columns, int rows, float duration) : Bird(filePath, columns, rows, duration) {}
-};
+    Uint32 getFrame() const
+    {
+        return frame.load(memory_order_relaxed);
+    }
 
-class Movement
-{
-    float speed;         // Speed of movement
-    Vector2f direction;  // Direction of movement (positive or negative x-axis)
-    bool goingRight;     // Indicates if the bird is moving right
+    void recordLatency(float milliseconds)
+    {
+        latencies[latencyCount % LatencyCapacity] = milliseconds;
+        latencyCount++;
+    }
 
-public:
-    Movement(float birdSpeed)
+    void getRecentLatencies(vector<float>& out) const
     {
-        speed = birdSpeed;
-        goingRight = true;
-        srand(time(0)); // Seed random generator
+        // Oldest first
+        size_t first = latencyCount > LatencyCapacity ? latencyCount - LatencyCapacity : 0;
+        out.clear();
+        for (size_t i = first; i < latencyCount; i++)
+        {
+            out.push_back(latencies[i % LatencyCapacity]);
+        }
     }
 
-    void randomizeStart(Sprite& sprite, const Vector2u& windowSize)
+    void getRecentFrames(vector<float>& times, vector<Uint32>& frameNumbers) const
     {
-        // Randomly choose a vertical position
-        float startY = rand() % (windowSize.y / 3);
+        // Oldest first
+        Uint32 last = getFrame();
+        Uint32 first = last > FrameCapacity ? last - FrameCapacity : 0;
+        times.clear();
+        frameNumbers.clear();
+        for (Uint32 f = first; f < last; f++)
+        {
+            times.push_back(frameTimes[f % FrameCapacity]);
+            frameNumbers.push_back(f);
+        }
+    }
 
-        // Randomly choose direction (0 = left to right, 1 = right to left)
-        goingRight = rand() % 2;
+    void getRecentSamples(vector<ProfileSample>& out, Uint32 sinceFrame = 0) const
+    {
+        // Copies what is still in the ring from the given frame on, oldest first
+        size_t count = sampleCount.load(memory_order_relaxed);
+        size_t first = count > SampleCapacity ? count - SampleCapacity : 0;
+        out.clear();
+        for (size_t i = count; i > first; i--)
+        {
+            // Sample i - 1 is only taken when its stamp says it was complete both before and after the copy
+            const SampleSlot& slot = samples[(i - 1) % SampleCapacity];
+            if (slot.stamp.load(memory_order_acquire) != i)
+            {
+                continue;
+            }
+            ProfileSample sample;
+            sample.name = slot.name.load(memory_order_relaxed);
+            sample.start = slot.start.load(memory_order_relaxed);
+            sample.duration = slot.duration.load(memory_order_relaxed);
+            sample.frame = slot.frame.load(memory_order_relaxed);
+            sample.thread = slot.thread.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.stamp.load(memory_order_relaxed) != i)
+            {
+                continue;
+            }
+            if (sample.frame < sinceFrame)
+            {
+                break;
+            }
+            out.push_back(sample);
+        }
+        reverse(out.begin(), out.end());
+    }
 
-        // Set position and direction
-        if (goingRight)
+    bool exportChromeTrace(const string& filePath) const
+    {
+        // Loads in chrome://tracing or Perfetto, times are in microseconds
+        vector<ProfileSample> recent;
+        getRecentSamples(recent);
+        ofstream file(filePath);
+        if (!file.is_open())
         {
-            sprite.setPosition(-sprite.getGlobalBounds().width, startY); // Start just off the left
-            direction = { 1.0f, 0.0f }; // Moving right
-            sprite.setScale(0.5f, 0.5f); // Ensure correct orientation
+            return false;
         }
-        else
+        file << fixed << setprecision(3); // Whole microseconds would blur short phases
+        file << "{\"traceEvents\":[\n";
+        for (size_t i = 0; i < recent.size(); i++)
         {
-            sprite.setPosition(windowSize.x + 50, startY); // Start just off the right
-            direction = { -1.0f, 0.0f }; // Moving left
-            sprite.setScale(-0.5f, 0.5f); // Flip horizontally
+            file << "{\"name\":\"" << recent[i].name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << recent[i].thread
+                 << ",\"ts\":" << recent[i].start / 1000.0 << ",\"dur\":" << recent[i].duration / 1000.0
+                 << ",\"args\":{\"frame\":" << recent[i].frame << "}}" << (i + 1 < recent.size() ? ",\n" : "\n");
         }
+        file << "]}\n";
+        return file.good();
     }
 
-    void update(Sprite& sprite, const Vector2u& windowSize)
+    bool exportCsv(const string& filePath) const
     {
-        // Move the sprite in the current direction
-        sprite.move(direction.x * speed, direction.y * speed);
-
-        // Reset the bird when it goes off-screen
-        if ((goingRight && sprite.getPosition().x > windowSize.x) || (!goingRight && sprite.getPosition().x < -sprite.getGlobalBounds().width))
+        vector<ProfileSample> recent;
+        getRecentSamples(recent);
+        ofstream file(filePath);
+        if (!file.is_open())
         {
-            randomizeStart(sprite, windowSize);
+            return false;
         }
+        file << fixed << setprecision(3);
+        file << "frame,thread,phase,start_us,duration_us\n";
+        for (size_t i = 0; i < recent.size(); i++)
+        {
+            file << recent[i].frame << "," << recent[i].thread << "," << recent[i].name << "," << recent[i].start / 1000.0 << "," << recent[i].duration / 1000.0 << "\n";
+        }
+        return file.good();
     }
 };
 
-
-class SinMovement
+// Times the enclosing block into a profiler, does nothing when there is no profiler
+class ScopedTimer
 {
-    float speed;         // Speed of movement along x-axis
-    float amplitude;     // Amplitude of the sine wave
-    float frequency;     // Frequency of the sine wave
-    Vector2f direction;  // Horizontal direction
-    bool goingRight;     // Indicates if the bird is moving right
-    float elapsedTime; // Tracks elapsed time for sine wave
-    bool issin;
+    Profiler* profiler;
+    const char* name;
+    long long start;
 
 public:
-    SinMovement(float birdSpeed, float waveAmplitude, float waveFrequency)
+    ScopedTimer(Profiler* profiler, const char* name) : profiler(profiler), name(name)
     {
-        speed = birdSpeed;
-        amplitude = waveAmplitude;
-        frequency = waveFrequency;
-        elapsedTime = 0.0f;
-        issin = true;
-        srand(time(0)); // Seed the random number generator
+        start = profiler ? nanosecondsNow() : 0;
     }
 
-    void randomizeStart(Sprite& sprite, const Vector2u& windowSize)
+    ~ScopedTimer()
     {
-        // Random vertical starting position
-        float startY = rand() % (windowSize.y / 4);
-
-        // Random horizontal direction
-        goingRight = rand() % 2;
-
-        if (goingRight)
-        {
-            sprite.setPosition(-sprite.getGlobalBounds().width, startY); // Start off the left side
-            direction = { 1.0f, 0.0f }; // Moving right
-            sprite.setScale(0.5f, 0.5f); // Ensure correct orientation
-        }
-        else
+        if (profiler)
         {
-            sprite.setPosition(windowSize.x + 50, startY); // Start off the right side
-            direction = { -1.0f, 0.0f }; // Moving left
-            sprite.setScale(-0.5f, 0.5f); // Flip horizontally
+            profiler->record(name, start, nanosecondsNow());
         }
-
-        elapsedTime = 0.0f; // Reset elapsed time for sine wave
     }
+};
 
-    void toggleMovementMode()
+// Small seedable random number generator (xorshift), one per subsystem so runs can be reproduced
+class Random
+{
+    Uint32 state;
+
+public:
+    Random(Uint32 seed = 1)
     {
-        issin = !issin; // Toggle between sinusoidal and straight movement
+        setSeed(seed);
     }
 
-    void update(Sprite& sprite, const Vector2u& windowSize, float deltaTime)
+    void setSeed(Uint32 seed)
     {
-        if (issin)
+        // Scramble the seed so nearby seeds give unrelated sequences, the state must never be zero
+        state = seed * 2654435761u ^ 0x9E3779B9u;
+        if (state == 0)
         {
-            elapsedTime += deltaTime;
+            state = 1;
+        }
+    }
 
-            // Calculate new x and y positions
-            float posX = sprite.getPosition().x + direction.x * speed * deltaTime;
-            float posY = sprite.getPosition().y + amplitude * sin(frequency * elapsedTime);
+    Uint32 next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
 
-            // Set new position
-            sprite.setPosition(posX, posY);
-        }
-        else
-        {
-            // Straight-line movement
-            sprite.move(direction.x * speed * deltaTime, 0);
-        }
+    unsigned int nextInt(unsigned int range)
+    {
+        // Number in [0, range)
+        return range > 0 ? next() % range : 0;
+    }
 
-        // Reset the bird when it goes off-screen
-        if ((goingRight && sprite.getPosition().x > windowSize.x) || (!goingRight && sprite.getPosition().x < -sprite.getGlobalBounds().width))
-        {
-            randomizeStart(sprite, windowSize);
-        }
+    float nextFloat(float low, float high)
+    {
+        // Number in [low, high), from the top 24 bits
+        return low + (high - low) * ((next() >> 8) * (1.0f / 16777216.0f));
     }
 };
 
-class PistolSprite
+// One bit per pixel telling whether the pixel is solid enough to be hit, stored as packed 32 bit rows
+class HitMask
 {
-    Texture pistolTexture;
-    Sprite pistolSprite;
-    Vector2u textureSize; // Total size of the texture
-    int frameWidth, frameHeight; // Dimensions of a single frame
-    int currentFrame; // Current frame index
-    int totalFrames; // Total number of frames in the sprite sheet
-    float frameDuration; // Time per frame (seconds)
-    Clock animationClock; // Clock for animation timing
-    bool isShooting; // Flag to indicate if shooting animation is active
-
-    Clock cooldownClock; // Clock to manage cooldown
-    float shootCooldown; // Cooldown time (seconds)
-
-    SoundBuffer fireSoundBuffer; // Sound buffer for shotgun firing
-    SoundBuffer reloadSoundBuffer; // Sound buffer for shotgun reloading
-    Sound fireSound; // Sound object for shotgun firing
-    Sound reloadSound; // Sound object for shotgun reloading
-
+    int width, height;
+    int wordsPerRow;
+    vector<Uint32> bits;
 
 public:
-    // Constructor
-    PistolSprite(const string& filePath, int columns, int rows, float duration)
+    HitMask()
     {
-        // Load the texture
-        pistolTexture.loadFromFile(filePath);
-        pistolSprite.setOrigin(400.f, 380.f);
-
-        // Set up texture properties
-        textureSize = pistolTexture.getSize();
-        frameWidth = (textureSize.x / columns);  // Divide texture width by number of columns
-        frameHeight = (textureSize.y / rows) - 10;    // Divide texture height by number of rows
-        totalFrames = columns * rows;          // Total number of frames
-        frameDuration = duration;              // Duration to display each frame
-
-        // Set up the sprite
-        pistolSprite.setTexture(pistolTexture);
-        pistolSprite.setTextureRect(IntRect(0, 0, frameWidth, frameHeight));  // Initial frame
-        pistolSprite.setScale(0.8f, 0.8f);  // Scale it down to fit the screen
-        currentFrame = 0;
-        isShooting = false;
-        shootCooldown = 0.74f; // Cooldown of 2 seconds between shots
-
-        // Load sound audio effects
-        fireSoundBuffer.loadFromFile("Sound Effects/shotgun firing.ogg");
-        reloadSoundBuffer.loadFromFile("Sound Effects/shotgun reload.ogg");
-
-        // Set up sounds
-        fireSound.setBuffer(fireSoundBuffer);
-        fireSound.setVolume(30); // Adjust volume as needed
-        reloadSound.setBuffer(reloadSoundBuffer);
-        reloadSound.setVolume(30); // Adjust volume as needed
+        width = height = 0;
+        wordsPerRow = 0;
     }
 
-    void startShooting()
+    HitMask(const Image& image, Uint8 alphaThreshold = 128)
+        : HitMask(image.getPixelsPtr(), image.getSize().x, IntRect(0, 0, image.getSize().x, image.getSize().y), alphaThreshold)
     {
-        if (cooldownClock.getElapsedTime().asSeconds() >= shootCooldown)
-        {
-            isShooting = true;
-            currentFrame = 0; // Reset animation to the first frame
-            animationClock.restart();
-            cooldownClock.restart();
-            fireSound.play();
-            reloadSound.play();
-        }
     }
 
-    void updateAnimation()
+    HitMask(const Uint8* pixels, unsigned int stride, const IntRect& area, Uint8 alphaThreshold = 128)
     {
-        if (isShooting)
+        // Mask of one area of an RGBA pixel block that is stride pixels wide
+        width = area.width;
+        height = area.height;
+        wordsPerRow = (width + 31) / 32;
+        bits.assign(wordsPerRow * height, 0);
+
+        for (int y = 0; y < height; y++)
         {
-            if (animationClock.getElapsedTime().asSeconds() > frameDuration)
+            for (int x = 0; x < width; x++)
             {
-                currentFrame++;
-                if (currentFrame >= totalFrames)
-                {
-                    isShooting = false; // Stop animation after the last frame
-                    currentFrame = 0;
-                }
-                else
+                if (pixels[((area.top + y) * stride + area.left + x) * 4 + 3] >= alphaThreshold)
                 {
-                    int frameX = (currentFrame % (textureSize.x / frameWidth)) * frameWidth;
-                    int frameY = (currentFrame / (textureSize.x / frameWidth)) * frameHeight;
-                    pistolSprite.setTextureRect(IntRect(frameX, frameY, frameWidth, frameHeight));
+                    bits[y * wordsPerRow + x / 32] |= 1u << (x % 32);
                 }
-                animationClock.restart();
             }
         }
     }
 
-
-    Sprite& getSprite()  // Provide access to the sprite
+    HitMask(const HitMask& source, const IntRect& area)
     {
-        return pistolSprite;
+        // Copy one frame out of a whole sprite sheet mask
+        width = area.width;
+        height = area.height;
+        wordsPerRow = (width + 31) / 32;
+        bits.assign(wordsPerRow * height, 0);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                if (source.test(area.left + x, area.top + y))
+                {
+                    bits[y * wordsPerRow + x / 32] |= 1u << (x % 32);
+                }
+            }
+        }
     }
 
-    void setPosition(float x, float y)
+    bool empty() const
     {
-        pistolSprite.setPosition(x, y);
+        return bits.empty();
     }
 
-    void rotateToMouse(float mouseX, float mouseY)
+    bool test(int x, int y) const
     {
-        // Get the sprite's current position
-        float spriteX = pistolSprite.getPosition().x;
-        float spriteY = pistolSprite.getPosition().y;
-
-        // Calculate the difference in positions
-        float dx = mouseX - spriteX - 8000; // Adjust the offset if needed
-        float dy = mouseY - spriteY;
-
-        // Use a simple ratio to determine rotation
-        float angle = (dy / dx) * 90.0f; // Map to a rough [-45, 45] range
-
-        // Clamp the angle to keep it between -45 and +45
-        if (angle < -45.0f) angle = -45.0f;
-        if (angle > 45.0f) angle = 45.0f;
-
-        // Apply rotation to the sprite
-        pistolSprite.setRotation(angle);
+        if (x < 0 || y < 0 || x >= width || y >= height)
+        {
+            return false;
+        }
+        return (bits[y * wordsPerRow + x / 32] >> (x % 32)) & 1u;
     }
-
 };
 
-void drawCrosshair(RenderWindow& window)
-{
-    // Get the size of the window
-    Vector2u windowSize = window.getSize();
-
-    // Get the current mouse position
-    Vector2i mousePos = Mouse::getPosition(window);
-
-    // Create the horizontal line of the crosshair
-    RectangleShape horizontalLine(Vector2f(windowSize.x / 15.f, 2.f)); // 10% of the screen width, 2px height
-    horizontalLine.setPosition(mousePos.x - horizontalLine.getSize().x / 2.f, mousePos.y - horizontalLine.getSize().y / 2.f);
-    horizontalLine.setFillColor(Color::White); // Set the color of the crosshair
-
-    // Create the vertical line of the crosshair
-    RectangleShape verticalLine(Vector2f(2.f, windowSize.y / 15.f)); // 10% of the screen height, 2px width
-    verticalLine.setPosition(mousePos.x - verticalLine.getSize().x / 2.f, mousePos.y - verticalLine.getSize().y / 2.f);
-    verticalLine.setFillColor(Color::White); // Set the color of the crosshair
-
-    // Draw the crosshair lines at the mouse position
-    window.draw(horizontalLine);
-    window.draw(verticalLine);
-}
-
-void constrainCursor(RenderWindow& window)
-{
-    // Get the current position of the mouse relative to the window
-    Vector2i mousePos = Mouse::getPosition(window);
-
-    // Get the size of the window
-    Vector2u windowSize = window.getSize();
-
-    // Constrain the mouse position to stay within the window bounds (only on the top half)
-    if (mousePos.x < 0) mousePos.x = 0;
-    if (mousePos.x > (int)windowSize.x - 1) mousePos.x = windowSize.x - 1;
-
-    // Constrain the vertical position to be within the top half of the screen
-    if (mousePos.y < 0) mousePos.y = 0;
-    if (mousePos.y > (int)windowSize.y / 1.5) mousePos.y = windowSize.y / 1.5;
-
-    // Reset the mouse position if it was outside the window bounds
-    Mouse::setPosition(mousePos, window);
-}
-
-void GameWindow(RenderWindow& window, Sprite& backgroundSprite, Font& font1, Font& font2, WhiteBird& white, BlueBird& blue, TurboBird& turbo, Bird& monster, string ScoreFile, int& score, int& highScore, int& streak)
+// Glyph metrics and positions baked from one font at one size, so text never touches FreeType at runtime
+class BitmapFont
 {
+public:
+    struct BakedGlyph
+    {
+        float advance; // Distance to the next glyph's origin
+        FloatRect bounds; // Quad relative to the origin on the baseline
+        IntRect textureRect; // Pixels inside the glyph page
+    };
 
+    static const int firstChar = 32; // Printable ASCII only
+    static const int lastChar = 126;
 
-    backgroundSprite.setColor(Color(255, 255, 255, 255 * 0.8));
-    window.setFramerateLimit(60);
-
-    Clock whiteCooldownClock;
-    Clock blueCooldownClock;
-    Clock turboCooldownClock;
-    Clock monsterCooldownClock;
-    float collisionCooldown = 1.2f; // Cooldown duration in seconds
-    bool isCollisionEnabled = false;
-    float clickCooldown = 0.75f; // 1 second cooldown between clicks
-    Clock clickCooldownClock; // Clock to track time since the last click
-
-    // Score
-    Text scoreText("Score: 0", font1, 24);
-    Text highScoreText("High Score: 0", font1, 24);
-    Text streakText("Streak: 0", font1, 24);
-    Text missText("Misses X 0", font1, 24); // Text for misses
-    missText.setFillColor(Color::Red); // Set the color of the misses text to red
-
-    // Game Over Text
-    Text gameOverText("Game Over", font1, 50);
-    gameOverText.setFillColor(Color::Red); // Set color to red
-    gameOverText.setPosition(window.getSize().x / 2 - 120, window.getSize().y / 2 - 50); // Center the text
-
-    Text finalScoreText("Final Score: 0", font1, 30);
-    finalScoreText.setFillColor(Color::White); // Set color to white
-    finalScoreText.setPosition(window.getSize().x / 2 - 100, window.getSize().y / 2 + 10); // Position below game over text
-
-    // Positioning
-    scoreText.setPosition(10, 10);
-    highScoreText.setPosition(10, 40);
-    streakText.setPosition(10, 70);
-    missText.setPosition(10, 450);
-
-    // In game Music
-    Music gameMusic;
-    gameMusic.openFromFile("Music/ingame music.ogg");
-    gameMusic.setLoop(true); // Set the music to loop
-    gameMusic.setVolume(100);
-    gameMusic.play();
-
-    bool turboBirdActive = false; // Flag to check if turbo bird is active
-    bool monsterActive = false;
-
-    // Pistol Sprite
-    PistolSprite shotgun("Textures/pump shotgun.png", 3, 2, 0.1f); // 3 frames per row, 2 row, 0.1 sec per frame
-    shotgun.setPosition(780.f, 790.f);  // Position of the pistol at the center of the screen
-
-    Clock clock;  // To keep track of delta time for animation
-
-    // Flag to track if the cursor is confined
-    bool cursorConstrained = false;
-
-    // Center the mouse cursor in the window
-    Mouse::setPosition(Vector2i(window.getSize().x / 3, window.getSize().y / 2), window);
-
-    Movement whiteMovement(3.0f);
-    whiteMovement.randomizeStart(white.getSprite(), window.getSize());
-
-    Movement blueMovement(4.0f);
-    blueMovement.randomizeStart(blue.getSprite(), window.getSize());
-
-    SinMovement turboMovement(300.0f, 7.0f, 10.0f); // Speed = 300, Amplitude = 7.0, Frequency = 10.0
-    turboMovement.randomizeStart(turbo.getSprite(), window.getSize());
-
-    SinMovement monsterMovement(200.0f, 7.0f, 5.0f); // Speed = 200, Amplitude = 7.0, Frequency = 5.0
-    monsterMovement.randomizeStart(monster.getSprite(), window.getSize());
-
-    Clock deltaClock;    // Clock for delta time
-    Clock modeSwitch;    // Clock to toggle turbo movement mode
+private:
+    vector<BakedGlyph> glyphs; // One per character from firstChar to lastChar
+    map<pair<char, char>, float> kernings; // Only the pairs that are not zero
+    unsigned int characterSize;
+    float lineSpacing;
+    Vector2i pageOffset; // Where the glyph page landed inside the atlas
 
-    // New variables for missed shots
-    int missedShots = 0; // Counter for missed shots
-    bool shotMissed = false; // Flag to indicate if the last shot was missed
+public:
+    BitmapFont()
+    {
+        glyphs.resize(lastChar - firstChar + 1);
+        characterSize = 0;
+        lineSpacing = 0.0f;
+    }
 
+    static string bakedName(const string& fontFile, unsigned int characterSize)
+    {
+        // "Fonts/Super Childish.ttf" at 24 becomes "Fonts/Super Childish 24"
+        string name = fontFile.substr(0, fontFile.rfind('.'));
+        return name + " " + to_string(characterSize);
+    }
 
-    while (window.isOpen())
+    bool load(const string& name)
     {
-        Event event;
-        while (window.pollEvent(event))
+        // Metrics are stored next to the page image as plain text
+        ifstream file(name + ".glyphs");
+        if (!file.is_open())
         {
-            if (event.type == Event::Closed)
-                window.close();
-            if (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape)
-            {
-                window.close();
-            }
+            return false;
+        }
+        return read(file);
+    }
 
-            // Toggle the cursor confinement when the Tab key is pressed
-            if (event.type == Event::KeyPressed && event.key.code == Keyboard::Tab)
+    bool read(istream& file)
+    {
+        file >> characterSize >> lineSpacing;
+        string kind;
+        while (file >> kind)
+        {
+            if (kind == "g")
             {
-                cursorConstrained = !cursorConstrained;
-                if (cursorConstrained)
-                {
-                    // Hide the cursor when it is confined
-                    window.setMouseCursorVisible(false);
-                }
-                else
+                int code;
+                BakedGlyph glyph;
+                file >> code >> glyph.advance
+                     >> glyph.bounds.left >> glyph.bounds.top >> glyph.bounds.width >> glyph.bounds.height
+                     >> glyph.textureRect.left >> glyph.textureRect.top >> glyph.textureRect.width >> glyph.textureRect.height;
+                if (code >= firstChar && code <= lastChar)
                 {
-                    // Show the cursor when it is free
-                    window.setMouseCursorVisible(true);
+                    glyphs[code - firstChar] = glyph;
                 }
             }
-
-            // Handle mouse click (shooting)
-            if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
+            else if (kind == "k")
             {
-                // Check if the cooldown has expired
-                if (clickCooldownClock.getElapsedTime().asSeconds() >= clickCooldown)
-                {
-                    isCollisionEnabled = true; // Enable collision detection
-                    shotgun.startShooting();   // Start the shooting animation
-                    clickCooldownClock.restart(); // Reset the cooldown timer
-                }
+                int first, second;
+                float kerning;
+                file >> first >> second >> kerning;
+                kernings[make_pair((char)first, (char)second)] = kerning;
             }
         }
-        // Update the shooting animation
-        shotgun.updateAnimation();
+        return !file.bad();
+    }
 
-        // If the cursor is confined, constrain its position within the window
-        if (cursorConstrained)
+    bool bake(const Font& font, unsigned int characterSize, const string& name, Image& page)
+    {
+        // Rasterize every character once through FreeType and keep the used part of the font's page
+        this->characterSize = characterSize;
+        lineSpacing = font.getLineSpacing(characterSize);
+        kernings.clear();
+        int pageWidth = 1, pageHeight = 1;
+        for (int code = firstChar; code <= lastChar; code++)
         {
-            constrainCursor(window);
+            const Glyph& glyph = font.getGlyph(code, characterSize, false);
+            BakedGlyph& baked = glyphs[code - firstChar];
+            baked.advance = glyph.advance;
+            baked.bounds = glyph.bounds;
+            baked.textureRect = glyph.textureRect;
+            pageWidth = max(pageWidth, glyph.textureRect.left + glyph.textureRect.width);
+            pageHeight = max(pageHeight, glyph.textureRect.top + glyph.textureRect.height);
         }
-
-        // Get the current mouse position
-        Vector2i mousePos = Mouse::getPosition(window);
-
-        // Check for collisions only when the pistol is shooting
-        if (isCollisionEnabled)
+        for (int first = firstChar; first <= lastChar; first++)
         {
-            bool hit = false; // Flag to check if a bird was hit
-
-            // White bird collision
-            if (white.getSprite().getGlobalBounds().contains(mousePos.x, mousePos.y) && whiteCooldownClock.getElapsedTime().asSeconds() > collisionCooldown)
-            {
-                score += 1; // Increment score
-                streak += 1; // Increment streak
-                whiteMovement.randomizeStart(white.getSprite(), window.getSize()); // Respawn bird
-                whiteCooldownClock.restart(); // Reset cooldown
-                isCollisionEnabled = false; // Disable collision after a hit
-                hit = true; // A bird was hit
-            }
-
-            // Blue bird collision
-            if (blue.getSprite().getGlobalBounds().contains(mousePos.x, mousePos.y) && blueCooldownClock.getElapsedTime().asSeconds() > collisionCooldown)
-            {
-                score += 2; // Increment score
-                streak += 1; // Increment streak
-                blueMovement.randomizeStart(blue.getSprite(), window.getSize()); // Respawn bird
-                blueCooldownClock.restart(); // Reset cooldown
-                isCollisionEnabled = false; // Disable collision after a hit
-                hit = true; // A bird was hit
-            }
-
-            // Turbo bird collision
-            if (turbo.getSprite().getGlobalBounds().contains(mousePos.x, mousePos.y) && turboCooldownClock.getElapsedTime().asSeconds() > collisionCooldown)
+            for (int second = firstChar; second <= lastChar; second++)
             {
-                score += 4; // Increment score
-                streak += 1; // Increment streak
-                turboMovement.randomizeStart(turbo.getSprite(), window.getSize()); // Respawn bird
-                turboCooldownClock.restart(); // Reset cooldown
-                isCollisionEnabled = false; // Disable collision after a hit
-                hit = true; // A bird was hit
-            }
-
-            // Turbo bird collision
-            if (monster.getSprite().getGlobalBounds().contains(mousePos.x, mousePos.y) && turboCooldownClock.getElapsedTime().asSeconds() > collisionCooldown)
-            {
-                score += 10; // Increment score
-                streak += 1; // Increment streak
-                monsterMovement.randomizeStart(monster.getSprite(), window.getSize()); // Respawn bird
-                monsterCooldownClock.restart(); // Reset cooldown
-                isCollisionEnabled = false; // Disable collision after a hit
-                hit = true; // A bird was hit
-            }
-
-            // If no bird was hit, increment missed shots
-            if (!hit)
-            {
-                missedShots++; // Increment missed shots
-                streak = 0;
-                if (missedShots >= 5)
+                float kerning = font.getKerning(first, second, characterSize);
+                if (kerning != 0.0f)
                 {
-                    score -= 10; // Deduct 10 points from score
+                    kernings[make_pair((char)first, (char)second)] = kerning;
                 }
             }
-            // Set isCollisionEnabled to false immediately after checking for collisions
-            isCollisionEnabled = false;
         }
 
-        if (missedShots >= 10)
+        Image fullPage = font.getTexture(characterSize).copyToImage();
+        page.create(pageWidth, pageHeight, Color::Transparent);
+        if (fullPage.getSize().x >= (unsigned int)pageWidth && fullPage.getSize().y >= (unsigned int)pageHeight)
         {
-            // Update final score text
-            finalScoreText.setString("Final Score: " + to_string(score));
-
-            // Render game over screen
-            window.clear(Color::Black);
-            window.draw(backgroundSprite);
-            window.draw(gameOverText);
-            window.draw(finalScoreText);
-            window.display();
-
-            // Wait for a moment before closing or restarting
-            sleep(seconds(3)); // Pause for 3 seconds
-            window.close(); // Close the window or you can restart the game here
-            return; // Exit the function
+            page.copy(fullPage, 0, 0, IntRect(0, 0, pageWidth, pageHeight));
         }
 
-        if (streak >= 6 && !turboBirdActive)
+        // Save the page, then the metrics, so later runs can skip FreeType
+        if (!page.saveToFile(name + ".png"))
         {
-            turboBirdActive = true; // Set the flag to true
-            turboMovement.randomizeStart(turbo.getSprite(), window.getSize()); // Spawn the Turbo Bird
+            return false;
         }
-
-        if (streak >= 8 && !monsterActive)
+        ofstream file(name + ".glyphs");
+        if (!file.is_open())
         {
-            monsterActive = true; // Set the flag to true
-            monsterMovement.randomizeStart(monster.getSprite(), window.getSize()); // Spawn the Turbo Bird
+            return false;
         }
+        write(file);
+        return file.good();
+    }
 
-        float deltaTime = deltaClock.restart().asSeconds(); // Time elapsed since the last frame
-
-        // Update bird animations and movements
-        white.updateAnimation();
-        whiteMovement.update(white.getSprite(), window.getSize());
-        blue.updateAnimation();
-        blueMovement.update(blue.getSprite(), window.getSize());
-        if (turboBirdActive) // Only update Turbo Bird if it's active
+    void write(ostream& file) const
+    {
+        file << characterSize << " " << lineSpacing << "\n";
+        for (int code = firstChar; code <= lastChar; code++)
         {
-            turbo.updateAnimation();
-            turboMovement.update(turbo.getSprite(), window.getSize(), deltaTime);
+            const BakedGlyph& glyph = glyphs[code - firstChar];
+            file << "g " << code << " " << glyph.advance << " "
+                 << glyph.bounds.left << " " << glyph.bounds.top << " " << glyph.bounds.width << " " << glyph.bounds.height << " "
+                 << glyph.textureRect.left << " " << glyph.textureRect.top << " " << glyph.textureRect.width << " " << glyph.textureRect.height << "\n";
         }
-
-        // Toggle turbo bird's movement mode every 3 seconds
-        if (modeSwitch.getElapsedTime().asSeconds() > 1.0f && turboBirdActive)
+        for (map<pair<char, char>, float>::const_iterator it = kernings.begin(); it != kernings.end(); ++it)
         {
-            turboMovement.toggleMovementMode();
-            modeSwitch.restart();
+            file << "k " << (int)it->first.first << " " << (int)it->first.second << " " << it->second << "\n";
         }
+    }
 
-        if (monsterActive) // Only update Turbo Bird if it's active
-        {
-            monster.updateAnimation();
-            monsterMovement.update(monster.getSprite(), window.getSize(), deltaTime);
-        }
+    void setPageOffset(const Vector2i& offset)
+    {
+        pageOffset = offset;
+    }
 
-        // Toggle turbo bird's movement mode every 3 seconds
-        if (modeSwitch.getElapsedTime().asSeconds() > 1.0f && monsterActive)
+    const BakedGlyph* getGlyph(char character) const
+    {
+        if (character < firstChar || character > lastChar)
         {
-            monsterMovement.toggleMovementMode();
-            modeSwitch.restart();
+            return nullptr;
         }
+        return &glyphs[character - firstChar];
+    }
 
-        // Update texts
-        scoreText.setString("Score: " + to_string(score));
-        highScoreText.setString("High Score: " + to_string(highScore));
-        streakText.setString("Streak: " + to_string(streak));
-        missText.setString("Misses X " + to_string(missedShots));
+    float getKerning(char first, char second) const
+    {
+        map<pair<char, char>, float>::const_iterator it = kernings.find(make_pair(first, second));
+        return it == kernings.end() ? 0.0f : it->second;
+    }
 
-        // Get mouse position
-        shotgun.rotateToMouse(mousePos.x, mousePos.y);
+    unsigned int getCharacterSize() const
+    {
+        return characterSize;
+    }
+
+    float getLineSpacing() const
+    {
+        return lineSpacing;
+    }
+
+    Vector2i getPageOffset() const
+    {
+        return pageOffset;
+    }
+};
+
+// One file holding every asset already decoded, mapped into memory instead of read and decoded at startup.
+// Little endian: "OOPSPAK1", entry count, then per entry kind, width, height, name length, offset, size and name.
+// Entry data follows the table, each entry starting on a 16 byte boundary.
+class AssetPack : NonCopyable
+{
+public:
+    enum EntryKind
+    {
+        PixelsEntry = 1, // RGBA pixels, width by height
+        SamplesEntry = 2, // 16 bit PCM, width is the channel count and height the sample rate
+        BlobEntry = 3 // File contents as they are (fonts, music, metadata)
+    };
+
+    struct Entry
+    {
+        Uint32 kind;
+        Uint32 width, height;
+        const Uint8* data; // Inside the mapped file
+        size_t size;
+    };
+
+private:
+    const Uint8* base; // Start of the mapped file, null when closed
+    size_t length;
+    map<string, Entry> entries;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+
+    static Uint32 readValue(const Uint8* bytes)
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+    }
+
+    bool readTable()
+    {
+        // Every entry is checked against the file size once, so lookups can trust it afterwards
+        if (length < 12 || memcmp(base, "OOPSPAK1", 8) != 0)
+        {
+            return false;
+        }
+        Uint32 count = readValue(base + 8);
+        size_t position = 12;
+        for (Uint32 i = 0; i < count; i++)
+        {
+            if (position + 24 > length)
+            {
+                return false;
+            }
+            Entry entry;
+            entry.kind = readValue(base + position);
+            entry.width = readValue(base + position + 4);
+            entry.height = readValue(base + position + 8);
+            Uint32 nameLength = readValue(base + position + 12);
+            Uint32 offset = readValue(base + position + 16);
+            entry.size = readValue(base + position + 20);
+            position += 24;
+            if (position + nameLength > length || offset > length || entry.size > length - offset)
+            {
+                return false;
+            }
+            if (entry.kind == PixelsEntry && entry.size != (size_t)entry.width * entry.height * 4)
+            {
+                return false;
+            }
+            entry.data = base + offset;
+            entries[string((const char*)base + position, nameLength)] = entry;
+            position += nameLength;
+        }
+        return true;
+    }
+
+public:
+    AssetPack()
+    {
+        base = nullptr;
+        length = 0;
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        file = -1;
+#endif
+    }
+
+    ~AssetPack()
+    {
+        close();
+    }
+
+    bool open(const string& filePath)
+    {
+        // Map the whole file read only, pages are only read from disk when something touches them
+        close();
+#ifdef _WIN32
+        file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        LARGE_INTEGER fileSize;
+        if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        base = mapping ? (const Uint8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        length = (size_t)fileSize.QuadPart;
+#else
+        file = ::open(filePath.c_str(), O_RDONLY);
+        struct stat info;
+        if (file < 0 || fstat(file, &info) != 0 || info.st_size == 0)
+        {
+            close();
+            return false;
+        }
+        void* mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        base = mapped == MAP_FAILED ? nullptr : (const Uint8*)mapped;
+        length = (size_t)info.st_size;
+#endif
+        if (!base || !readTable())
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        entries.clear();
+#ifdef _WIN32
+        if (base)
+        {
+            UnmapViewOfFile(base);
+        }
+        if (mapping)
+        {
+            CloseHandle(mapping);
+        }
+        if (file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file);
+        }
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (base)
+        {
+            munmap((void*)base, length);
+        }
+        if (file >= 0)
+        {
+            ::close(file);
+        }
+        file = -1;
+#endif
+        base = nullptr;
+        length = 0;
+    }
+
+    bool isOpen() const
+    {
+        return base != nullptr;
+    }
+
+    const Entry* find(const string& name, Uint32 kind) const
+    {
+        // Null when the pack is closed or has no entry of that kind by that name
+        map<string, Entry>::const_iterator it = entries.find(name);
+        if (it == entries.end() || it->second.kind != kind)
+        {
+            return nullptr;
+        }
+        return &it->second;
+    }
+};
+
+// Collects decoded assets and writes them out as one asset pack, used by --pack ahead of time
+class AssetPackWriter
+{
+    struct PendingEntry
+    {
+        string name;
+        Uint32 kind;
+        Uint32 width, height;
+        vector<Uint8> bytes;
+    };
+    vector<PendingEntry> entries;
+
+    static void writeValue(ostream& out, Uint32 value)
+    {
+        char bytes[4] = { (char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24) };
+        out.write(bytes, 4);
+    }
+
+    void add(const string& name, Uint32 kind, Uint32 width, Uint32 height, const void* data, size_t size)
+    {
+        PendingEntry entry;
+        entry.name = name;
+        entry.kind = kind;
+        entry.width = width;
+        entry.height = height;
+        entry.bytes.assign((const Uint8*)data, (const Uint8*)data + size);
+        entries.push_back(entry);
+    }
+
+public:
+    void addPixels(const string& name, const Image& image)
+    {
+        add(name, AssetPack::PixelsEntry, image.getSize().x, image.getSize().y, image.getPixelsPtr(), (size_t)image.getSize().x * image.getSize().y * 4);
+    }
+
+    bool addSound(const string& filePath)
+    {
+        // Decoded now so the game only copies samples
+        SoundBuffer buffer;
+        if (!buffer.loadFromFile(filePath))
+        {
+            return false;
+        }
+        add(filePath, AssetPack::SamplesEntry, buffer.getChannelCount(), buffer.getSampleRate(), buffer.getSamples(), (size_t)buffer.getSampleCount() * sizeof(Int16));
+        return true;
+    }
+
+    bool addFile(const string& filePath)
+    {
+        // Stored as it is, for files the game reads straight from memory
+        ifstream in(filePath, ios::binary);
+        if (!in.is_open())
+        {
+            return false;
+        }
+        string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        addBlob(filePath, contents);
+        return true;
+    }
+
+    void addBlob(const string& name, const string& contents)
+    {
+        add(name, AssetPack::BlobEntry, 0, 0, contents.data(), contents.size());
+    }
+
+    bool save(const string& filePath) const
+    {
+        ofstream out(filePath, ios::binary);
+        if (!out.is_open())
+        {
+            return false;
+        }
+
+        // Data starts after the table, every entry aligned to 16 bytes
+        size_t offset = 12;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            offset += 24 + entries[i].name.size();
+        }
+        vector<Uint32> offsets(entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            offset = (offset + 15) & ~(size_t)15;
+            offsets[i] = (Uint32)offset;
+            offset += entries[i].bytes.size();
+        }
+
+        out.write("OOPSPAK1", 8);
+        writeValue(out, (Uint32)entries.size());
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            writeValue(out, entries[i].kind);
+            writeValue(out, entries[i].width);
+            writeValue(out, entries[i].height);
+            writeValue(out, (Uint32)entries[i].name.size());
+            writeValue(out, offsets[i]);
+            writeValue(out, (Uint32)entries[i].bytes.size());
+            out.write(entries[i].name.data(), entries[i].name.size());
+        }
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            while ((size_t)out.tellp() < offsets[i])
+            {
+                out.put(0);
+            }
+            out.write((const char*)entries[i].bytes.data(), entries[i].bytes.size());
+        }
+        return out.good();
+    }
+};
+
+class AssetManager
+{
+    map<string, shared_ptr<SoundBuffer>> sounds; // Decoded sound effects, loaded once per file
+    map<string, shared_ptr<Font>> fonts; // Fonts, loaded once per file
+
+    vector<string> atlasFiles; // Images queued for packing into the atlas
+    map<string, IntRect> atlasRegions; // Where each packed image ended up inside the atlas
+    vector<string> hitMaskFiles; // Packed images that also need a hit mask
+    map<string, HitMask> hitMasks; // Alpha hit masks, built from the decoded pixels while packing
+    map<string, Image> memoryImages; // Images made at runtime rather than loaded from a file
+    map<string, BitmapFont> bitmapFonts; // Baked fonts, their pages are packed into the atlas
+    Image atlasImage; // Packed atlas pixels, kept on the CPU until uploaded
+    Texture atlasTexture; // One texture holding every packed sprite sheet
+    vector<shared_ptr<Texture>> extraPages; // Pages packed later by the asset loader, one texture each
+    map<string, const Texture*> pageTextures; // Texture of every image that is not on the main atlas
+    const string solidRegionName = "#solid"; // Name of the plain white block packed with the images
+    const string packedAtlasName = "#atlas"; // Name of the ready packed atlas inside an asset pack
+    const AssetPack* pack; // Checked before any loose file, may be null
+
+    void placeBitmapFonts()
+    {
+        // Baked glyph pages are part of the atlas
+        for (map<string, BitmapFont>::iterator it = bitmapFonts.begin(); it != bitmapFonts.end(); ++it)
+        {
+            IntRect region = atlasRegions[it->first + ".png"];
+            it->second.setPageOffset(Vector2i(region.left, region.top));
+        }
+    }
+
+public:
+    AssetManager()
+    {
+        pack = nullptr;
+    }
+
+    void setPack(const AssetPack* assetPack)
+    {
+        pack = assetPack;
+    }
+
+    shared_ptr<SoundBuffer> getSound(const string& filePath)
+    {
+        shared_ptr<SoundBuffer>& buffer = sounds[filePath];
+        if (!buffer)
+        {
+            buffer = make_shared<SoundBuffer>();
+            const AssetPack::Entry* entry = pack ? pack->find(filePath, AssetPack::SamplesEntry) : nullptr;
+            if (entry)
+            {
+                buffer->loadFromSamples((const Int16*)entry->data, entry->size / sizeof(Int16), entry->width, entry->height);
+            }
+            else
+            {
+                buffer->loadFromFile(filePath);
+            }
+        }
+        return buffer;
+    }
+
+    shared_ptr<Font> getFont(const string& filePath)
+    {
+        shared_ptr<Font>& font = fonts[filePath];
+        if (!font)
+        {
+            // A font read from the pack keeps reading the mapped file, which stays open as long as the game runs
+            font = make_shared<Font>();
+            const AssetPack::Entry* entry = pack ? pack->find(filePath, AssetPack::BlobEntry) : nullptr;
+            if (entry)
+            {
+                font->loadFromMemory(entry->data, entry->size);
+            }
+            else
+            {
+                font->loadFromFile(filePath);
+            }
+        }
+        return font;
+    }
+
+    bool openMusic(Music& music, const string& filePath) const
+    {
+        // Music streams while it plays, from the mapped pack when it is in there
+        const AssetPack::Entry* entry = pack ? pack->find(filePath, AssetPack::BlobEntry) : nullptr;
+        if (entry)
+        {
+            return music.openFromMemory(entry->data, entry->size);
+        }
+        return music.openFromFile(filePath);
+    }
+
+    void addSound(const string& filePath, const vector<Int16>& samples, unsigned int channelCount, unsigned int sampleRate)
+    {
+        // Take over samples decoded elsewhere, usually on the loader thread
+        shared_ptr<SoundBuffer>& buffer = sounds[filePath];
+        if (!buffer)
+        {
+            buffer = make_shared<SoundBuffer>();
+            buffer->loadFromSamples(samples.data(), samples.size(), channelCount, sampleRate);
+        }
+    }
+
+    void addToAtlas(const string& filePath, bool buildHitMask = false)
+    {
+        // Queue an image to be packed the next time the atlas is built
+        if (find(atlasFiles.begin(), atlasFiles.end(), filePath) == atlasFiles.end())
+        {
+            atlasFiles.push_back(filePath);
+        }
+        if (buildHitMask && find(hitMaskFiles.begin(), hitMaskFiles.end(), filePath) == hitMaskFiles.end())
+        {
+            hitMaskFiles.push_back(filePath);
+        }
+    }
+
+    void addBitmapFont(const string& fontFile, unsigned int characterSize, bool rebake = false)
+    {
+        // Load a baked font, or bake it now (and save it for next time) if it has not been baked yet
+        string name = BitmapFont::bakedName(fontFile, characterSize);
+        if (bitmapFonts.count(name))
+        {
+            return;
+        }
+        BitmapFont& font = bitmapFonts[name];
+        const AssetPack::Entry* metrics = pack ? pack->find(name + ".glyphs", AssetPack::BlobEntry) : nullptr;
+        bool loaded = false;
+        if (!rebake && metrics)
+        {
+            istringstream in(string((const char*)metrics->data, metrics->size));
+            loaded = font.read(in);
+        }
+        else if (!rebake)
+        {
+            loaded = font.load(name);
+        }
+        if (!loaded)
+        {
+            if (!font.bake(*getFont(fontFile), characterSize, name, memoryImages[name + ".png"]))
+            {
+                cout << "Could not save baked font " << name << endl;
+            }
+        }
+        addToAtlas(name + ".png");
+    }
+
+    const BitmapFont& getBitmapFont(const string& fontFile, unsigned int characterSize) const
+    {
+        static const BitmapFont noFont;
+        map<string, BitmapFont>::const_iterator it = bitmapFonts.find(BitmapFont::bakedName(fontFile, characterSize));
+        if (it == bitmapFonts.end())
+        {
+            return noFont;
+        }
+        return it->second;
+    }
+
+    void buildAtlas()
+    {
+        if (!loadPackedAtlas())
+        {
+            packAtlas(min(4096u, Texture::getMaximumSize()));
+            uploadAtlas();
+        }
+    }
+
+    bool loadPackedAtlas()
+    {
+        // An asset pack holds the atlas already packed, so nothing is decoded and the texture is filled from the mapped pixels
+        const AssetPack::Entry* pixels = pack ? pack->find(packedAtlasName, AssetPack::PixelsEntry) : nullptr;
+        const AssetPack::Entry* table = pack ? pack->find(packedAtlasName + ".regions", AssetPack::BlobEntry) : nullptr;
+        if (!pixels || !table || pixels->width > Texture::getMaximumSize() || pixels->height > Texture::getMaximumSize())
+        {
+            return false;
+        }
+
+        // One line per image: left top width height name
+        map<string, IntRect> regions;
+        istringstream in(string((const char*)table->data, table->size));
+        IntRect region;
+        string name;
+        while (in >> region.left >> region.top >> region.width >> region.height && getline(in >> ws, name))
+        {
+            if (region.left < 0 || region.top < 0 || region.left + region.width > (int)pixels->width || region.top + region.height > (int)pixels->height)
+            {
+                return false;
+            }
+            regions[name] = region;
+        }
+
+        // Everything queued has to be in there, otherwise the pack is older than the game
+        addToAtlas(solidRegionName);
+        for (size_t i = 0; i < atlasFiles.size(); i++)
+        {
+            if (!regions.count(atlasFiles[i]))
+            {
+                return false;
+            }
+        }
+
+        if (!atlasTexture.create(pixels->width, pixels->height))
+        {
+            return false;
+        }
+        atlasTexture.update(pixels->data);
+        atlasRegions = regions;
+        for (size_t i = 0; i < hitMaskFiles.size(); i++)
+        {
+            hitMasks[hitMaskFiles[i]] = HitMask(pixels->data, pixels->width, atlasRegions[hitMaskFiles[i]]);
+        }
+        memoryImages.clear();
+        placeBitmapFonts();
+        return true;
+    }
+
+    void writePackedAtlas(AssetPackWriter& writer) const
+    {
+        // After packAtlas: the atlas as it would be uploaded, where everything is in it, and the baked font metrics
+        writer.addPixels(packedAtlasName, atlasImage);
+        ostringstream regions;
+        for (map<string, IntRect>::const_iterator it = atlasRegions.begin(); it != atlasRegions.end(); ++it)
+        {
+            regions << it->second.left << " " << it->second.top << " " << it->second.width << " " << it->second.height << " " << it->first << "\n";
+        }
+        writer.addBlob(packedAtlasName + ".regions", regions.str());
+        for (map<string, BitmapFont>::const_iterator it = bitmapFonts.begin(); it != bitmapFonts.end(); ++it)
+        {
+            ostringstream metrics;
+            it->second.write(metrics);
+            writer.addBlob(it->first + ".glyphs", metrics.str());
+        }
+    }
+
+    void packAtlas(unsigned int atlasWidth)
+    {
+        // Decodes and packs the images on the CPU only, so it also works without a window or GPU
+
+        // Decode every queued image once, plus a small white block for untextured shapes
+        addToAtlas(solidRegionName);
+        vector<Image> images(atlasFiles.size());
+        for (size_t i = 0; i < atlasFiles.size(); i++)
+        {
+            if (atlasFiles[i] == solidRegionName)
+            {
+                images[i].create(4, 4, Color::White);
+            }
+            else if (memoryImages.count(atlasFiles[i]))
+            {
+                images[i] = memoryImages[atlasFiles[i]];
+            }
+            else
+            {
+                images[i].loadFromFile(atlasFiles[i]);
+            }
+
+            // Hit masks come from the decoded pixels, which are gone once the atlas is uploaded
+            if (find(hitMaskFiles.begin(), hitMaskFiles.end(), atlasFiles[i]) != hitMaskFiles.end())
+            {
+                hitMasks[atlasFiles[i]] = HitMask(images[i]);
+            }
+        }
+
+        atlasRegions.clear();
+        packImages(atlasFiles, images, atlasWidth, atlasRegions, atlasImage);
+        memoryImages.clear();
+        placeBitmapFonts();
+    }
+
+    static void packImages(const vector<string>& names, const vector<Image>& images, unsigned int pageWidth, map<string, IntRect>& regions, Image& page)
+    {
+        // Shelf packing on the CPU only, so any thread can do it
+        const unsigned int padding = 2; // Empty pixels between images so neighbours never bleed into each other
+
+        // Pack tallest images first into horizontal shelves
+        vector<size_t> order(images.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        sort(order.begin(), order.end(), [&images](size_t a, size_t b) { return images[a].getSize().y > images[b].getSize().y; });
+
+        vector<Vector2u> shelves; // x = used width, y = top of the shelf
+        vector<unsigned int> shelfHeights;
+        unsigned int pageHeight = 0;
+        for (size_t i : order)
+        {
+            Vector2u size = images[i].getSize();
+            size_t shelf = 0;
+            while (shelf < shelves.size() && (shelves[shelf].x + size.x > pageWidth || size.y > shelfHeights[shelf]))
+            {
+                shelf++;
+            }
+            if (shelf == shelves.size())
+            {
+                // No existing shelf has room, open a new one underneath
+                shelves.push_back(Vector2u(0, pageHeight));
+                shelfHeights.push_back(size.y);
+                pageHeight += size.y + padding;
+            }
+            regions[names[i]] = IntRect(shelves[shelf].x, shelves[shelf].y, size.x, size.y);
+            shelves[shelf].x += size.x + padding;
+        }
+
+        // Copy everything into one image
+        page.create(pageWidth, max(pageHeight, 1u), Color::Transparent);
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            IntRect region = regions[names[i]];
+            page.copy(images[i], region.left, region.top);
+        }
+    }
+
+    void uploadAtlas()
+    {
+        // Send the packed atlas to the GPU once and drop the CPU copy
+        atlasTexture.loadFromImage(atlasImage);
+        atlasImage = Image();
+    }
+
+    void addPage(const Image& pixels, const map<string, IntRect>& regions)
+    {
+        // Upload a page that was packed elsewhere, its images are then found like any other
+        shared_ptr<Texture> page = make_shared<Texture>();
+        page->loadFromImage(pixels);
+        extraPages.push_back(page);
+        for (map<string, IntRect>::const_iterator it = regions.begin(); it != regions.end(); ++it)
+        {
+            atlasRegions[it->first] = it->second;
+            pageTextures[it->first] = page.get();
+        }
+    }
+
+    const Texture& getAtlas() const
+    {
+        return atlasTexture;
+    }
+
+    const Texture& getTexture(const string& filePath) const
+    {
+        // Texture holding the given image, the main atlas unless the image was loaded onto a later page
+        map<string, const Texture*>::const_iterator it = pageTextures.find(filePath);
+        if (it == pageTextures.end())
+        {
+            return atlasTexture;
+        }
+        return *it->second;
+    }
+
+    IntRect getRegion(const string& filePath) const
+    {
+        // Area of the atlas holding the given image
+        map<string, IntRect>::const_iterator it = atlasRegions.find(filePath);
+        if (it == atlasRegions.end())
+        {
+            return IntRect();
+        }
+        return it->second;
+    }
+
+    const HitMask& getHitMask(const string& filePath) const
+    {
+        // Empty when the image was not queued with a hit mask or failed to load
+        static const HitMask noMask;
+        map<string, HitMask>::const_iterator it = hitMasks.find(filePath);
+        if (it == hitMasks.end())
+        {
+            return noMask;
+        }
+        return it->second;
+    }
+
+    void setAtlasSprite(Sprite& sprite, const string& filePath) const
+    {
+        // Point a sprite at an image packed in the atlas
+        sprite.setTexture(getTexture(filePath));
+        sprite.setTextureRect(getRegion(filePath));
+    }
+
+    IntRect getSolidRegion() const
+    {
+        // A few pixels inside the solid white block packed into the atlas, used for untextured shapes
+        IntRect region = getRegion(solidRegionName);
+        return IntRect(region.left + 1, region.top + 1, 1, 1);
+    }
+};
+
+// Decodes assets on a worker thread so the render thread is only left with the GPU upload
+class AssetLoader
+{
+    struct DecodedSound
+    {
+        string filePath;
+        vector<Int16> samples;
+        unsigned int channelCount; // 0 when the file could not be decoded
+        unsigned int sampleRate;
+    };
+
+    vector<string> imageFiles; // Images packed onto the loader's own atlas page
+    vector<string> soundFiles; // Sound effects decoded into samples
+    unsigned int pageWidth;
+    const AssetPack* pack; // Already decoded copies, used instead of the files when present
+
+    // Written by the worker, read by the render thread only once decoded is set
+    Image page;
+    map<string, IntRect> regions;
+    vector<DecodedSound> decodedSounds;
+
+    thread worker;
+    atomic<int> completed; // Files decoded so far
+    atomic<bool> decoded; // Everything is decoded and packed, waiting for the upload
+    bool started;
+    bool uploaded;
+
+    void decode()
+    {
+        vector<Image> images(imageFiles.size());
+        for (size_t i = 0; i < imageFiles.size(); i++)
+        {
+            const AssetPack::Entry* entry = pack ? pack->find(imageFiles[i], AssetPack::PixelsEntry) : nullptr;
+            if (entry)
+            {
+                images[i].create(entry->width, entry->height, entry->data);
+            }
+            else
+            {
+                images[i].loadFromFile(imageFiles[i]);
+            }
+            completed.fetch_add(1, memory_order_relaxed);
+        }
+
+        decodedSounds.resize(soundFiles.size());
+        for (size_t i = 0; i < soundFiles.size(); i++)
+        {
+            DecodedSound& sound = decodedSounds[i];
+            sound.filePath = soundFiles[i];
+            sound.channelCount = 0;
+            sound.sampleRate = 0;
+            const AssetPack::Entry* entry = pack ? pack->find(soundFiles[i], AssetPack::SamplesEntry) : nullptr;
+            InputSoundFile file;
+            if (entry)
+            {
+                sound.samples.assign((const Int16*)entry->data, (const Int16*)entry->data + entry->size / sizeof(Int16));
+                sound.channelCount = entry->width;
+                sound.sampleRate = entry->height;
+            }
+            else if (file.openFromFile(soundFiles[i]))
+            {
+                sound.samples.resize((size_t)file.getSampleCount());
+                sound.samples.resize((size_t)file.read(sound.samples.data(), sound.samples.size()));
+                sound.channelCount = file.getChannelCount();
+                sound.sampleRate = file.getSampleRate();
+            }
+            completed.fetch_add(1, memory_order_relaxed);
+        }
+
+        AssetManager::packImages(imageFiles, images, pageWidth, regions, page);
+        decoded.store(true, memory_order_release);
+    }
+
+public:
+    AssetLoader(const AssetPack* assetPack = nullptr) : completed(0), decoded(false)
+    {
+        pack = assetPack;
+        pageWidth = 2048;
+        started = false;
+        uploaded = false;
+    }
+
+    ~AssetLoader()
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    void addImage(const string& filePath)
+    {
+        imageFiles.push_back(filePath);
+    }
+
+    void addSound(const string& filePath)
+    {
+        soundFiles.push_back(filePath);
+    }
+
+    const vector<string>& getImageFiles() const
+    {
+        return imageFiles;
+    }
+
+    const vector<string>& getSoundFiles() const
+    {
+        return soundFiles;
+    }
+
+    void start(unsigned int width)
+    {
+        // Begin decoding in the background, later calls do nothing
+        if (started)
+        {
+            return;
+        }
+        started = true;
+        pageWidth = width;
+        worker = thread(&AssetLoader::decode, this);
+    }
+
+    bool update(AssetManager& assets)
+    {
+        // Called on the render thread, uploads once the worker is done and returns true when everything is in place
+        if (!uploaded && started && decoded.load(memory_order_acquire))
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+            assets.addPage(page, regions);
+            for (size_t i = 0; i < decodedSounds.size(); i++)
+            {
+                if (decodedSounds[i].channelCount > 0)
+                {
+                    assets.addSound(decodedSounds[i].filePath, decodedSounds[i].samples, decodedSounds[i].channelCount, decodedSounds[i].sampleRate);
+                }
+            }
+            page = Image();
+            decodedSounds.clear();
+            uploaded = true;
+        }
+        return uploaded;
+    }
+
+    void finish(AssetManager& assets)
+    {
+        // Block until everything is loaded, for when there was no time to load in the background
+        start(pageWidth);
+        if (!uploaded)
+        {
+            worker.join();
+            update(assets);
+        }
+    }
+
+    bool isReady() const
+    {
+        return uploaded;
+    }
+
+    float getProgress() const
+    {
+        // The upload counts as the last step
+        if (uploaded)
+        {
+            return 1.0f;
+        }
+        return completed.load(memory_order_relaxed) / (float)(imageFiles.size() + soundFiles.size() + 1);
+    }
+};
+
+// Collects textured quads for a whole frame and submits them in as few draw calls as possible
+class SpriteBatch
+{
+    RenderTarget* target;
+    VertexArray vertices; // Quads waiting to be drawn, two triangles each
+    const Texture* texture; // Texture shared by every queued quad
+    BlendMode blendMode; // Blend mode shared by every queued quad
+    IntRect solidRegion; // Plain white area of the atlas for untextured rectangles
+    int drawCalls; // Draw calls issued since begin()
+
+    void switchState(const Texture* newTexture, const BlendMode& newBlendMode)
+    {
+        // A new texture or blend mode ends the current batch
+        if (newTexture != texture || newBlendMode != blendMode)
+        {
+            flush();
+            texture = newTexture;
+            blendMode = newBlendMode;
+        }
+    }
+
+    void appendQuad(const Vector2f corners[4], const FloatRect& texRect, const Color& color)
+    {
+        // Corners go top-left, top-right, bottom-right, bottom-left
+        Vector2f texCoords[4] =
+        {
+            Vector2f(texRect.left, texRect.top),
+            Vector2f(texRect.left + texRect.width, texRect.top),
+            Vector2f(texRect.left + texRect.width, texRect.top + texRect.height),
+            Vector2f(texRect.left, texRect.top + texRect.height)
+        };
+        const int order[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < 6; i++)
+        {
+            vertices.append(Vertex(corners[order[i]], color, texCoords[order[i]]));
+        }
+    }
+
+public:
+    SpriteBatch()
+    {
+        target = nullptr;
+        vertices.setPrimitiveType(Triangles);
+        texture = nullptr;
+        blendMode = BlendAlpha;
+        drawCalls = 0;
+    }
+
+    void setSolidRegion(const IntRect& region)
+    {
+        solidRegion = region;
+    }
+
+    void begin(RenderTarget& renderTarget)
+    {
+        target = &renderTarget;
+        vertices.clear(); // Keeps its capacity, so a steady frame never reallocates
+        texture = nullptr;
+        blendMode = BlendAlpha;
+        drawCalls = 0;
+    }
+
+    void flush()
+    {
+        if (vertices.getVertexCount() > 0 && target)
+        {
+            RenderStates states(blendMode);
+            states.texture = texture;
+            target->draw(vertices, states);
+            drawCalls++;
+        }
+        vertices.clear();
+    }
+
+    int end()
+    {
+        flush();
+        target = nullptr;
+        return drawCalls;
+    }
+
+    void draw(const Sprite& sprite, const BlendMode& spriteBlendMode = BlendAlpha)
+    {
+        switchState(sprite.getTexture(), spriteBlendMode);
+
+        // Same geometry sf::Sprite would build, moved into world space with its transform
+        IntRect rect = sprite.getTextureRect();
+        float width = (float)abs(rect.width);
+        float height = (float)abs(rect.height);
+        const Transform& transform = sprite.getTransform();
+        Vector2f corners[4] =
+        {
+            transform.transformPoint(0.0f, 0.0f),
+            transform.transformPoint(width, 0.0f),
+            transform.transformPoint(width, height),
+            transform.transformPoint(0.0f, height)
+        };
+        appendQuad(corners, FloatRect(rect), sprite.getColor());
+    }
+
+    void drawQuad(const Texture& quadTexture, const FloatRect& destination, const IntRect& textureRect, bool flipX, const Color& color = Color::White)
+    {
+        // Axis aligned textured rectangle, optionally mirrored horizontally
+        switchState(&quadTexture, BlendAlpha);
+        Vector2f corners[4] =
+        {
+            Vector2f(destination.left, destination.top),
+            Vector2f(destination.left + destination.width, destination.top),
+            Vector2f(destination.left + destination.width, destination.top + destination.height),
+            Vector2f(destination.left, destination.top + destination.height)
+        };
+        FloatRect texRect(textureRect);
+        if (flipX)
+        {
+            texRect.left += texRect.width;
+            texRect.width = -texRect.width;
+        }
+        appendQuad(corners, texRect, color);
+    }
+
+    void drawRect(const Texture& atlas, const FloatRect& destination, const Color& color)
+    {
+        // Untextured rectangle, sampled from the solid white block of the atlas
+        drawQuad(atlas, destination, solidRegion, false, color);
+    }
+
+    void drawVertices(const Texture& verticesTexture, const vector<Vertex>& triangles, const Vector2f& offset = Vector2f())
+    {
+        // Geometry that was laid out ahead of time (e.g. text), optionally moved by an offset
+        switchState(&verticesTexture, BlendAlpha);
+        for (size_t i = 0; i < triangles.size(); i++)
+        {
+            Vertex vertex = triangles[i];
+            vertex.position += offset;
+            vertices.append(vertex);
+        }
+    }
+
+    void draw(const Drawable& drawable, const RenderStates& states = RenderStates::Default)
+    {
+        // Anything that is not an atlas sprite (e.g. text) is drawn on its own, after what is queued so far
+        flush();
+        if (target)
+        {
+            target->draw(drawable, states);
+            drawCalls++;
+        }
+    }
+};
+
+// Text drawn from a baked font in the atlas, laid out again only when its string, position or color changes
+class BitmapText
+{
+    const BitmapFont* font;
+    const Texture* texture; // The atlas holding the font's glyph page
+    string text;
+    Vector2f position;
+    Color color;
+    vector<Vertex> triangles; // Two triangles per visible glyph, already in window space
+    FloatRect localBounds;
+    bool dirty; // Set when the triangles no longer match the text
+
+    void layout()
+    {
+        // Same placement as sf::Text: the first baseline sits one character size below the top
+        triangles.clear();
+        dirty = false;
+        localBounds = FloatRect();
+        if (!font || !texture)
+        {
+            return;
+        }
+
+        Vector2i offset = font->getPageOffset();
+        float x = 0.0f;
+        float y = (float)font->getCharacterSize();
+        float minX = 0.0f, minY = 0.0f, maxX = 0.0f, maxY = 0.0f;
+        bool first = true;
+        char previous = 0;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            char character = text[i];
+            x += font->getKerning(previous, character);
+            previous = character;
+            if (character == '\n')
+            {
+                x = 0.0f;
+                y += font->getLineSpacing();
+                continue;
+            }
+            const BitmapFont::BakedGlyph* glyph = font->getGlyph(character);
+            if (!glyph)
+            {
+                continue;
+            }
+
+            float left = x + glyph->bounds.left;
+            float top = y + glyph->bounds.top;
+            float right = left + glyph->bounds.width;
+            float bottom = top + glyph->bounds.height;
+            float u1 = (float)(offset.x + glyph->textureRect.left);
+            float v1 = (float)(offset.y + glyph->textureRect.top);
+            float u2 = u1 + glyph->textureRect.width;
+            float v2 = v1 + glyph->textureRect.height;
+            if (glyph->textureRect.width > 0 && glyph->textureRect.height > 0)
+            {
+                triangles.push_back(Vertex(position + Vector2f(left, top), color, Vector2f(u1, v1)));
+                triangles.push_back(Vertex(position + Vector2f(right, top), color, Vector2f(u2, v1)));
+                triangles.push_back(Vertex(position + Vector2f(right, bottom), color, Vector2f(u2, v2)));
+                triangles.push_back(Vertex(position + Vector2f(left, top), color, Vector2f(u1, v1)));
+                triangles.push_back(Vertex(position + Vector2f(right, bottom), color, Vector2f(u2, v2)));
+                triangles.push_back(Vertex(position + Vector2f(left, bottom), color, Vector2f(u1, v2)));
+
+                if (first)
+                {
+                    minX = left;
+                    minY = top;
+                    maxX = right;
+                    maxY = bottom;
+                    first = false;
+                }
+                minX = min(minX, left);
+                minY = min(minY, top);
+                maxX = max(maxX, right);
+                maxY = max(maxY, bottom);
+            }
+            x += glyph->advance;
+        }
+        localBounds = FloatRect(minX, minY, maxX - minX, maxY - minY);
+    }
+
+public:
+    BitmapText()
+    {
+        font = nullptr;
+        texture = nullptr;
+        color = Color::White;
+        dirty = true;
+    }
+
+    BitmapText(const string& string, const BitmapFont& bitmapFont, const Texture& atlas)
+    {
+        font = &bitmapFont;
+        texture = &atlas;
+        text = string;
+        color = Color::White;
+        dirty = true;
+    }
+
+    void setFont(const BitmapFont& bitmapFont, const Texture& atlas)
+    {
+        font = &bitmapFont;
+        texture = &atlas;
+        dirty = true;
+    }
+
+    void setString(const string& string)
+    {
+        if (string != text)
+        {
+            text = string;
+            dirty = true;
+        }
+    }
+
+    void setPosition(float x, float y)
+    {
+        if (position.x != x || position.y != y)
+        {
+            position = Vector2f(x, y);
+            dirty = true;
+        }
+    }
+
+    void setFillColor(const Color& fillColor)
+    {
+        if (fillColor != color)
+        {
+            color = fillColor;
+            dirty = true;
+        }
+    }
+
+    FloatRect getLocalBounds()
+    {
+        if (dirty)
+        {
+            layout();
+        }
+        return localBounds;
+    }
+
+    FloatRect getGlobalBounds()
+    {
+        FloatRect bounds = getLocalBounds();
+        return FloatRect(bounds.left + position.x, bounds.top + position.y, bounds.width, bounds.height);
+    }
+
+    void draw(SpriteBatch& batch)
+    {
+        if (dirty)
+        {
+            layout();
+        }
+        if (texture)
+        {
+            batch.drawVertices(*texture, triangles);
+        }
+    }
+};
+
+// A HUD label followed by a number, only rebuilt when the number changes
+class HudCounter
+{
+    BitmapText text;
+    string label;
+    int value;
+    bool hasValue;
+
+public:
+    HudCounter(const string& label, const BitmapFont& font, const Texture& atlas) : text(label + "0", font, atlas), label(label)
+    {
+        value = 0;
+        hasValue = false;
+    }
+
+    void setValue(int newValue)
+    {
+        if (!hasValue || newValue != value)
+        {
+            value = newValue;
+            hasValue = true;
+            text.setString(label + to_string(value));
+        }
+    }
+
+    BitmapText& getText()
+    {
+        return text;
+    }
+
+    void draw(SpriteBatch& batch)
+    {
+        text.draw(batch);
+    }
+};
+
+// Presents each frame on time: either at a target rate, sleeping through most of the wait and spinning the last part,
+// or as vsync lets it. OS sleeps can overshoot by a millisecond or more (the old setFramerateLimit jittered by that much),
+// so the spin covers the worst overshoot seen lately. A frame is also started only as early as the recent frames needed,
+// rather than straight after the last present, so it is made from fresher input.
+// Records the time between presented frames and the age of the input each one showed, to measure the result.
+class FramePacer
+{
+public:
+    enum Mode
+    {
+        LimitedPacing, // Hybrid sleep and spin to the target rate
+        VSyncPacing, // The driver waits for the display in display()
+        UnlimitedPacing // As fast as frames can be made
+    };
+
+    // Spread of the recent frame intervals, in milliseconds
+    struct Stats
+    {
+        size_t frames;
+        float inputAge; // Average time from a frame reading its input to its present
+        float mean;
+        float deviation; // Standard deviation
+        float p99;
+        float worst;
+        size_t late; // Frames that took over half an interval longer than the target rate allows
+    };
+
+    enum
+    {
+        IntervalCapacity = 1024, // Frame intervals kept for the statistics
+        MinSpinMicroseconds = 200,
+        MaxSpinMicroseconds = 4000
+    };
+
+private:
+    Mode mode;
+    float targetRate; // Frames per second when limited
+    long long period; // Nanoseconds per frame
+    long long deadline; // When the next frame should start, 0 to start again from now
+    long long spinMargin; // The last part of a wait that is spun rather than slept (nanoseconds)
+    long long workEstimate; // Longest a frame has taken to make lately, it is started this long before its present
+    long long frameStart; // When the frame being made started
+    vector<float> intervals; // Milliseconds between presents, interval i at i % IntervalCapacity
+    size_t intervalCount;
+    long long lastPresent;
+    double inputAgeTotal; // Milliseconds from the start of each frame to its present, over the recorded frames
+    vector<float> sorted; // Scratch space for the percentile
+
+public:
+    FramePacer(float rate = 60.0f, Mode pacingMode = LimitedPacing) : intervals(IntervalCapacity, 0.0f)
+    {
+        spinMargin = 2000000;
+        workEstimate = 0;
+        frameStart = 0;
+        setTarget(rate, pacingMode);
+    }
+
+    void setTarget(float rate, Mode pacingMode)
+    {
+        // A rate of 0 is the same as unlimited
+        mode = rate > 0.0f || pacingMode == VSyncPacing ? pacingMode : UnlimitedPacing;
+        targetRate = rate;
+        period = rate > 0.0f ? (long long)(1e9 / rate) : 0;
+        deadline = 0;
+        intervalCount = 0;
+        lastPresent = 0;
+        inputAgeTotal = 0.0;
+    }
+
+    void apply(Window& window) const
+    {
+        // The pacer does the limiting, SFML's own limiter would only add its jitter on top
+        window.setFramerateLimit(0);
+        window.setVerticalSyncEnabled(mode == VSyncPacing);
+    }
+
+    void cycle(Window& window)
+    {
+        // 60, 144 and 240 Hz, vsync, unlimited, then round again
+        const float rates[] = { 60.0f, 144.0f, 240.0f };
+        if (mode == LimitedPacing && targetRate < rates[2])
+        {
+            setTarget(targetRate < rates[1] ? rates[1] : rates[2], LimitedPacing);
+        }
+        else if (mode == LimitedPacing)
+        {
+            setTarget(targetRate, VSyncPacing);
+        }
+        else if (mode == VSyncPacing)
+        {
+            setTarget(0.0f, UnlimitedPacing);
+        }
+        else
+        {
+            setTarget(rates[0], LimitedPacing);
+        }
+        apply(window);
+    }
+
+    void beginFrame()
+    {
+        // Called before the frame reads its input, waits until there is only just enough time left to make it
+        long long now = nanosecondsNow();
+        if (mode == LimitedPacing)
+        {
+            if (deadline == 0 || now - deadline > period)
+            {
+                deadline = now + period; // A whole frame behind: start again from now rather than rushing frames out to catch up
+            }
+            now = waitUntil(deadline - min(workEstimate, period));
+        }
+        frameStart = now;
+    }
+
+    void waitToPresent()
+    {
+        // Called just before display(), holds the finished frame until its present time
+        if (mode != LimitedPacing)
+        {
+            return;
+        }
+        long long now = nanosecondsNow();
+        long long work = now - frameStart;
+        workEstimate = max(workEstimate - workEstimate / 32, work + work / 4); // Jumps up with a slow frame, eases back down
+        waitUntil(deadline);
+        deadline += period;
+    }
+
+    long long waitUntil(long long target)
+    {
+        // Sleep while there is more than the margin left, widening the margin whenever a sleep overshoots it
+        long long now = nanosecondsNow();
+        while (target - now > spinMargin)
+        {
+            long long request = target - now - spinMargin;
+            sf::sleep(microseconds(request / 1000));
+            long long woke = nanosecondsNow();
+            long long overshoot = woke - now - request;
+            spinMargin = max(spinMargin - spinMargin / 64, overshoot + overshoot / 4);
+            spinMargin = min(max(spinMargin, (long long)MinSpinMicroseconds * 1000), (long long)MaxSpinMicroseconds * 1000);
+            now = woke;
+        }
+        while (now < target)
+        {
+            this_thread::yield();
+            now = nanosecondsNow();
+        }
+        return now;
+    }
+
+    void presented(long long presentTime)
+    {
+        if (lastPresent != 0)
+        {
+            intervals[intervalCount % IntervalCapacity] = (presentTime - lastPresent) / 1e6f;
+            intervalCount++;
+            inputAgeTotal += (presentTime - frameStart) / 1e6;
+        }
+        lastPresent = presentTime;
+    }
+
+    Stats getStats()
+    {
+        Stats stats = { 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0 };
+        stats.frames = min(intervalCount, (size_t)IntervalCapacity);
+        if (stats.frames == 0)
+        {
+            return stats;
+        }
+        stats.inputAge = (float)(inputAgeTotal / intervalCount);
+        sorted.assign(intervals.begin(), intervals.begin() + stats.frames);
+        double total = 0.0;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            total += sorted[i];
+        }
+        stats.mean = (float)(total / stats.frames);
+        double squares = 0.0;
+        float lateAfter = period / 1e6f * 1.5f;
+        for (size_t i = 0; i < sorted.size(); i++)
+        {
+            squares += (sorted[i] - stats.mean) * (sorted[i] - stats.mean);
+            if (period > 0 && sorted[i] > lateAfter)
+            {
+                stats.late++;
+            }
+        }
+        stats.deviation = (float)sqrt(squares / stats.frames);
+        sort(sorted.begin(), sorted.end());
+        stats.p99 = sorted[(stats.frames - 1) * 99 / 100];
+        stats.worst = sorted.back();
+        return stats;
+    }
+
+    string describe() const
+    {
+        if (mode == VSyncPacing)
+        {
+            return "vsync";
+        }
+        if (mode == UnlimitedPacing)
+        {
+            return "unlimited";
+        }
+        return to_string((int)targetRate) + " Hz";
+    }
+
+    bool isVSync() const
+    {
+        return mode == VSyncPacing;
+    }
+
+    float getFrameBudget() const
+    {
+        // Milliseconds a frame may take, unlimited frames are held to 60 a second
+        return period > 0 ? period / 1e6f : 1000.0f / 60.0f;
+    }
+};
+
+// Every scene draws in one logical resolution, the 900x800 the game was laid out for, whatever the window's size.
+// A frame is rendered into an offscreen texture at a scale that adapts to how long frames take to make, then stretched
+// over the largest part of the window with the same shape, leaving black bars on the sides that don't fit.
+class LogicalScreen
+{
+public:
+    enum
+    {
+        LogicalWidth = 900,
+        LogicalHeight = 800,
+        MinQuality = 5, // Lowest render scale, in tenths of the window's own resolution
+        MaxQuality = 10
+    };
+
+private:
+    RenderWindow& window;
+    string title; // For recreating the window when going fullscreen and back
+    bool fullscreen;
+    RenderTexture target; // Sized for the largest render scale, a smaller scale renders into its top-left corner
+    Vector2u targetSize;
+    Sprite frame; // The rendered part of the target, stretched over the letterbox
+    FloatRect letterbox; // Window pixels the logical screen covers
+    float nativeScale; // Render scale giving one target pixel per window pixel, as far as textures allow
+    int quality; // Render scale in tenths of nativeScale
+    bool dynamic; // Whether the quality follows the frame time
+    float averageMs; // Smoothed time to make a frame
+    float settleTime; // Seconds before the quality may change again
+
+    void applyScale()
+    {
+        // Render into the part of the target the scale uses
+        float scale = getRenderScale();
+        Vector2u size = getRenderSize();
+        View view(FloatRect(0, 0, (float)LogicalWidth, (float)LogicalHeight));
+        view.setViewport(FloatRect(0, 0, LogicalWidth * scale / targetSize.x, LogicalHeight * scale / targetSize.y));
+        target.setView(view);
+        frame.setTextureRect(IntRect(0, 0, size.x, size.y));
+        frame.setPosition(letterbox.left, letterbox.top);
+        frame.setScale(letterbox.width / size.x, letterbox.height / size.y);
+    }
+
+public:
+    LogicalScreen(RenderWindow& window, const string& title) : window(window), title(title)
+    {
+        fullscreen = false;
+        targetSize = Vector2u(0, 0);
+        nativeScale = 1.0f;
+        quality = MaxQuality;
+        dynamic = true;
+        averageMs = 0.0f;
+        settleTime = 0.0f;
+        resize();
+    }
+
+    void resize()
+    {
+        // Called whenever the window changes size, the logical layout stays as it is
+        Vector2u windowSize = window.getSize();
+        window.setView(View(FloatRect(0, 0, (float)windowSize.x, (float)windowSize.y)));
+        float fit = min(windowSize.x / (float)LogicalWidth, windowSize.y / (float)LogicalHeight);
+        letterbox.width = LogicalWidth * fit;
+        letterbox.height = LogicalHeight * fit;
+        letterbox.left = floor((windowSize.x - letterbox.width) / 2);
+        letterbox.top = floor((windowSize.y - letterbox.height) / 2);
+
+        // The target only ever grows, so shrinking the window or the scale never reallocates it
+        float largest = Texture::getMaximumSize() / (float)max(LogicalWidth, LogicalHeight);
+        nativeScale = max(0.1f, min(fit, largest));
+        Vector2u needed((unsigned int)ceil(LogicalWidth * nativeScale), (unsigned int)ceil(LogicalHeight * nativeScale));
+        if (needed.x > targetSize.x || needed.y > targetSize.y)
+        {
+            targetSize = Vector2u(max(needed.x, targetSize.x), max(needed.y, targetSize.y));
+            target.create(targetSize.x, targetSize.y);
+            target.setSmooth(true);
+            frame.setTexture(target.getTexture());
+        }
+        applyScale();
+    }
+
+    void toggleFullscreen()
+    {
+        // The window is created again, so whoever set up its frame limit and vsync has to apply them again
+        fullscreen = !fullscreen;
+        if (fullscreen)
+        {
+            window.create(VideoMode::getDesktopMode(), title, Style::Fullscreen);
+        }
+        else
+        {
+            window.create(VideoMode(LogicalWidth, LogicalHeight), title, Style::Default);
+        }
+        resize();
+    }
+
+    void setFixedQuality(int tenths)
+    {
+        // Stops the adapting, at tenths of the window's resolution
+        dynamic = false;
+        quality = min(max(tenths, (int)MinQuality), (int)MaxQuality);
+        applyScale();
+    }
+
+    void adapt(float frameMs, float budgetMs, float deltaTime)
+    {
+        // Drop the quality quickly when frames run close to the budget, raise it slowly once there is plenty of room
+        averageMs += (frameMs - averageMs) * 0.1f;
+        settleTime -= deltaTime;
+        if (!dynamic || settleTime > 0.0f)
+        {
+            return;
+        }
+        if (averageMs > budgetMs * 0.85f && quality > MinQuality)
+        {
+            quality--;
+            settleTime = 0.5f;
+            applyScale();
+        }
+        else if (averageMs < budgetMs * 0.5f && quality < MaxQuality)
+        {
+            quality++;
+            settleTime = 2.0f;
+            applyScale();
+        }
+    }
+
+    RenderTarget& beginFrame(bool clear)
+    {
+        if (clear)
+        {
+            target.clear(Color::Black);
+        }
+        return target;
+    }
+
+    void present()
+    {
+        // Stretch the frame over the window, the bars around it are cleared every time
+        target.display();
+        window.clear(Color::Black);
+        window.draw(frame);
+    }
+
+    Vector2u getSize() const
+    {
+        return Vector2u(LogicalWidth, LogicalHeight);
+    }
+
+    float getRenderScale() const
+    {
+        return nativeScale * quality / MaxQuality;
+    }
+
+    Vector2u getRenderSize() const
+    {
+        float scale = getRenderScale();
+        return Vector2u(max(1u, (unsigned int)(LogicalWidth * scale + 0.5f)), max(1u, (unsigned int)(LogicalHeight * scale + 0.5f)));
+    }
+
+    Vector2i toLogical(const Vector2i& pixel) const
+    {
+        return Vector2i((int)floor((pixel.x - letterbox.left) * LogicalWidth / letterbox.width),
+            (int)floor((pixel.y - letterbox.top) * LogicalHeight / letterbox.height));
+    }
+
+    Vector2i toPixel(const Vector2i& logical) const
+    {
+        return Vector2i((int)(letterbox.left + (logical.x + 0.5f) * letterbox.width / LogicalWidth),
+            (int)(letterbox.top + (logical.y + 0.5f) * letterbox.height / LogicalHeight));
+    }
+
+    Vector2i getMouse() const
+    {
+        return toLogical(Mouse::getPosition(window));
+    }
+
+    void setMouse(const Vector2i& logical)
+    {
+        Mouse::setPosition(toPixel(logical), window);
+    }
+
+    void translate(Event& event) const
+    {
+        // Mouse events arrive in window pixels, scenes want them in logical coordinates
+        if (event.type == Event::MouseButtonPressed || event.type == Event::MouseButtonReleased)
+        {
+            Vector2i position = toLogical(Vector2i(event.mouseButton.x, event.mouseButton.y));
+            event.mouseButton.x = position.x;
+            event.mouseButton.y = position.y;
+        }
+        else if (event.type == Event::MouseMoved)
+        {
+            Vector2i position = toLogical(Vector2i(event.mouseMove.x, event.mouseMove.y));
+            event.mouseMove.x = position.x;
+            event.mouseMove.y = position.y;
+        }
+        else if (event.type == Event::MouseWheelScrolled)
+        {
+            Vector2i position = toLogical(Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y));
+            event.mouseWheelScroll.x = position.x;
+            event.mouseWheelScroll.y = position.y;
+        }
+    }
+};
+
+// On-screen frame statistics: frame time percentiles, the worst recent frames and the cost of each phase
+class ProfilerOverlay
+{
+    Profiler& profiler;
+    FramePacer* pacer; // Its frame intervals are shown too when set
+    LogicalScreen* screen; // Its render scale is shown too when set
+    const Texture& atlas;
+    BitmapText text;
+    bool visible;
+    float refreshTime; // Seconds since the text was last rebuilt
+
+    // Scratch space reused between refreshes
+    vector<float> times;
+    vector<Uint32> frameNumbers;
+    vector<float> sorted;
+    vector<ProfileSample> recent;
+    vector<float> latencies;
+
+    void refresh()
+    {
+        profiler.getRecentFrames(times, frameNumbers);
+        if (times.empty())
+        {
+            return;
+        }
+        sorted = times;
+        sort(sorted.begin(), sorted.end());
+        size_t last = sorted.size() - 1;
+
+        char line[128];
+        string report;
+        snprintf(line, sizeof(line), "Frame ms over %u frames\n", (unsigned int)sorted.size());
+        report += line;
+        snprintf(line, sizeof(line), "p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+            sorted[last * 50 / 100], sorted[last * 90 / 100], sorted[last * 99 / 100], sorted[last]);
+        report += line;
+
+        // The three longest frames still in the history
+        report += "Worst:";
+        vector<size_t> order(times.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        size_t worstCount = min((size_t)3, order.size());
+        partial_sort(order.begin(), order.begin() + worstCount, order.end(), [this](size_t a, size_t b) { return times[a] > times[b]; });
+        for (size_t i = 0; i < worstCount; i++)
+        {
+            snprintf(line, sizeof(line), "  #%u %.2f", frameNumbers[order[i]], times[order[i]]);
+            report += line;
+        }
+        report += "\n";
+
+        // How evenly frames reach the screen
+        if (pacer)
+        {
+            FramePacer::Stats pacing = pacer->getStats();
+            snprintf(line, sizeof(line), "Pacing %s: mean %.2f  sd %.3f  p99 %.2f  late %u  input %.1f\n",
+                pacer->describe().c_str(), pacing.mean, pacing.deviation, pacing.p99, (unsigned int)pacing.late, pacing.inputAge);
+            report += line;
+        }
+        if (screen)
+        {
+            Vector2u size = screen->getRenderSize();
+            snprintf(line, sizeof(line), "Render %ux%u (scale %.2f)\n", size.x, size.y, screen->getRenderScale());
+            report += line;
+        }
+
+        // Click to photon over the last shots
+        profiler.getRecentLatencies(latencies);
+        if (!latencies.empty())
+        {
+            float total = 0.0f;
+            for (size_t i = 0; i < latencies.size(); i++)
+            {
+                total += latencies[i];
+            }
+            snprintf(line, sizeof(line), "Click to photon ms: last %.1f  avg %.1f  max %.1f\n",
+                latencies.back(), total / latencies.size(), *max_element(latencies.begin(), latencies.end()));
+            report += line;
+        }
+
+        // Average milliseconds per frame spent in each phase over the last second or so
+        const Uint32 window = 60;
+        Uint32 current = profiler.getFrame();
+        Uint32 since = current > window ? current - window : 0;
+        profiler.getRecentSamples(recent, since);
+        map<string, long long> phaseTotals;
+        for (size_t i = 0; i < recent.size(); i++)
+        {
+            phaseTotals[recent[i].name] += recent[i].duration;
+        }
+        Uint32 frames = max(current - since, 1u);
+        for (map<string, long long>::const_iterator it = phaseTotals.begin(); it != phaseTotals.end(); ++it)
+        {
+            snprintf(line, sizeof(line), "%-14s %.3f ms\n", it->first.c_str(), it->second / 1e6 / frames);
+            report += line;
+        }
+        text.setString(report);
+    }
+
+public:
+    ProfilerOverlay(Profiler& profiler, const BitmapFont& font, const Texture& atlas) : profiler(profiler), atlas(atlas), text("", font, atlas)
+    {
+        pacer = nullptr;
+        screen = nullptr;
+        visible = false;
+        refreshTime = 0.0f;
+        text.setPosition(620.0f, 10.0f);
+        text.setFillColor(Color::Yellow);
+    }
+
+    void setPacer(FramePacer& framePacer)
+    {
+        pacer = &framePacer;
+    }
+
+    void setScreen(LogicalScreen& logicalScreen)
+    {
+        screen = &logicalScreen;
+    }
+
+    void toggle()
+    {
+        visible = !visible;
+        refreshTime = 1.0f; // Refresh straight away when shown
+    }
+
+    bool isVisible() const
+    {
+        return visible;
+    }
+
+    void update(float deltaTime)
+    {
+        // Rebuilding the text a few times a second is plenty to read, and keeps the overlay off the profile
+        refreshTime += deltaTime;
+        if (visible && refreshTime >= 0.25f)
+        {
+            refreshTime = 0.0f;
+            refresh();
+        }
+    }
+
+    void draw(SpriteBatch& batch)
+    {
+        FloatRect bounds = text.getGlobalBounds();
+        batch.drawRect(atlas, FloatRect(bounds.left - 6, bounds.top - 6, bounds.width + 12, bounds.height + 12), Color(0, 0, 0, 170));
+        text.draw(batch);
+    }
+};
+
+// What a timer does when it expires, handled by whoever started it
+enum TimerKind
+{
+    BirdReadyTimer, // A hit bird can be hit again, the data is the bird
+    ClickReadyTimer, // The gun can fire again
+    ModeSwitchTimer, // Wavy birds switch between straight and sine wave flight
+    PistolReadyTimer // The shooting animation can start again
+};
+
+struct TimerEvent
+{
+    Uint32 kind; // TimerKind
+    Uint32 data; // Whatever the timer was started with
+};
+
+// Timers counted in whole ticks, kept in a hierarchical wheel so starting, cancelling and expiring one costs the same however many are pending.
+// Level 0 has a slot for each of the next 64 ticks and every level above spans 64 times the one below; when a level wraps round,
+// the next slot of the level above is cascaded down into it.
+class TimerWheel
+{
+public:
+    enum
+    {
+        NoTimer = 0xFFFFFFFF // Handle of no timer, also ends the slot lists
+    };
+
+private:
+    enum
+    {
+        SlotBits = 6,
+        Slots = 1 << SlotBits,
+        Levels = 4, // 2^24 ticks, over 38 hours at 120 Hz, later timers wait in the top level
+        IndexBits = 20 // Low bits of a handle, the rest is the timer's generation
+    };
+
+    struct Timer
+    {
+        Uint64 due; // Tick it expires on
+        Uint32 period; // Ticks between expiries of a repeating timer, 0 for a one-off
+        TimerEvent event;
+        Uint32 previous, next; // Neighbours in its slot's list, next also links the free list
+        Uint32 slot; // Slot it is listed in, NoTimer while free
+        Uint32 generation; // Bumped each time it is freed, so old handles stop matching
+    };
+
+    vector<Timer> timers; // Pool, only grows when more timers are pending than ever before
+    Uint32 freeTimers; // First unused timer
+    Uint32 heads[Levels * Slots];
+    Uint32 tails[Levels * Slots];
+    Uint64 now; // Current tick
+
+    void link(Uint32 index)
+    {
+        // Far off timers wait in the top level and are placed again when it comes round
+        Timer& timer = timers[index];
+        Uint64 due = min(timer.due, now + ((Uint64)1 << (Levels * SlotBits)) - 1);
+        Uint64 delta = due - now;
+        int level = 0;
+        while (level < Levels - 1 && delta >= ((Uint64)1 << ((level + 1) * SlotBits)))
+        {
+            level++;
+        }
+        Uint32 slot = level * Slots + (Uint32)((due >> (level * SlotBits)) & (Slots - 1));
+
+        // Appended, so timers due on the same tick expire in the order they were started
+        timer.slot = slot;
+        timer.previous = tails[slot];
+        timer.next = NoTimer;
+        if (tails[slot] != NoTimer)
+        {
+            timers[tails[slot]].next = index;
+        }
+        else
+        {
+            heads[slot] = index;
+        }
+        tails[slot] = index;
+    }
+
+    void unlink(Uint32 index)
+    {
+        Timer& timer = timers[index];
+        if (timer.previous != NoTimer)
+        {
+            timers[timer.previous].next = timer.next;
+        }
+        else
+        {
+            heads[timer.slot] = timer.next;
+        }
+        if (timer.next != NoTimer)
+        {
+            timers[timer.next].previous = timer.previous;
+        }
+        else
+        {
+            tails[timer.slot] = timer.previous;
+        }
+    }
+
+    void release(Uint32 index)
+    {
+        Timer& timer = timers[index];
+        timer.slot = NoTimer;
+        timer.generation = (timer.generation + 1) & ((1u << (32 - IndexBits)) - 1);
+        timer.next = freeTimers;
+        freeTimers = index;
+    }
+
+    Uint32 takeSlot(Uint32 slot)
+    {
+        // Empties a slot and returns its list
+        Uint32 index = heads[slot];
+        heads[slot] = tails[slot] = NoTimer;
+        return index;
+    }
+
+public:
+    TimerWheel()
+    {
+        freeTimers = NoTimer;
+        clear();
+    }
+
+    void reserve(size_t count)
+    {
+        timers.reserve(count);
+    }
+
+    void clear()
+    {
+        // Drops every pending timer but keeps the pool
+        for (Uint32 i = 0; i < Levels * Slots; i++)
+        {
+            heads[i] = tails[i] = NoTimer;
+        }
+        freeTimers = NoTimer;
+        for (size_t i = timers.size(); i-- > 0;)
+        {
+            if (timers[i].slot != NoTimer)
+            {
+                release((Uint32)i);
+            }
+            else
+            {
+                timers[i].next = freeTimers;
+                freeTimers = (Uint32)i;
+            }
+        }
+        now = 0;
+    }
+
+    Uint64 getNow() const
+    {
+        return now;
+    }
+
+    Uint32 start(Uint32 ticks, const TimerEvent& event, bool repeat = false)
+    {
+        // Expires after the given number of ticks, at least one, returns a handle for cancel()
+        ticks = max(ticks, 1u);
+        Uint32 index = freeTimers;
+        if (index != NoTimer)
+        {
+            freeTimers = timers[index].next;
+        }
+        else
+        {
+            index = (Uint32)timers.size();
+            timers.push_back(Timer());
+            timers[index].generation = 0;
+        }
+        Timer& timer = timers[index];
+        timer.due = now + ticks;
+        timer.period = repeat ? ticks : 0;
+        timer.event = event;
+        link(index);
+        return index | (timer.generation << IndexBits);
+    }
+
+    bool isPending(Uint32 handle) const
+    {
+        Uint32 index = handle & ((1u << IndexBits) - 1);
+        return handle != NoTimer && index < timers.size() && timers[index].slot != NoTimer && timers[index].generation == handle >> IndexBits;
+    }
+
+    void cancel(Uint32 handle)
+    {
+        if (isPending(handle))
+        {
+            Uint32 index = handle & ((1u << IndexBits) - 1);
+            unlink(index);
+            release(index);
+        }
+    }
+
+    void advance(vector<TimerEvent>& expired)
+    {
+        // One tick on, appending what expired to the list
+        now++;
+        for (int level = 1; level < Levels; level++)
+        {
+            if (now & (((Uint64)1 << (level * SlotBits)) - 1))
+            {
+                break;
+            }
+            Uint32 index = takeSlot(level * Slots + (Uint32)((now >> (level * SlotBits)) & (Slots - 1)));
+            while (index != NoTimer)
+            {
+                Uint32 next = timers[index].next;
+                link(index);
+                index = next;
+            }
+        }
+
+        // Everything left in this tick's slot is due now
+        Uint32 index = takeSlot((Uint32)(now & (Slots - 1)));
+        while (index != NoTimer)
+        {
+            Timer& timer = timers[index];
+            Uint32 next = timer.next;
+            expired.push_back(timer.event);
+            if (timer.period)
+            {
+                timer.due += timer.period;
+                link(index);
+            }
+            else
+            {
+                release(index);
+            }
+            index = next;
+        }
+    }
+};
+
+// The time of one simulation or scene, read once per tick or frame. Anything that waits, a cooldown, an animation step,
+// a mode switch, does so on the clock's timer wheel instead of polling a clock of its own.
+class GameClock
+{
+    TimerWheel timers;
+    vector<TimerEvent> expired; // Timers that expired during the last advance()
+    float tickLength; // Seconds per wheel tick
+    double time; // Seconds since reset
+
+public:
+    GameClock(float tickLength = 1.0f / 120.0f) : tickLength(tickLength)
+    {
+        time = 0.0;
+    }
+
+    void reserve(size_t count)
+    {
+        timers.reserve(count);
+        expired.reserve(count);
+    }
+
+    void reset()
+    {
+        timers.clear();
+        expired.clear();
+        time = 0.0;
+    }
+
+    Uint32 ticksFor(float seconds) const
+    {
+        // Rounded to whole ticks, at least one
+        return (Uint32)max(1.0, floor(seconds / tickLength + 0.5));
+    }
+
+    Uint32 start(TimerKind kind, Uint32 data, float seconds, bool repeat = false)
+    {
+        TimerEvent event = { (Uint32)kind, data };
+        return timers.start(ticksFor(seconds), event, repeat);
+    }
+
+    void cancel(Uint32 timer)
+    {
+        timers.cancel(timer);
+    }
+
+    const vector<TimerEvent>& advance(float deltaTime)
+    {
+        // Steps the wheel over every whole tick that passed and returns the timers that expired, in order
+        expired.clear();
+        time += deltaTime;
+        Uint64 target = (Uint64)(time / tickLength + 1e-6);
+        while (timers.getNow() < target)
+        {
+            timers.advance(expired);
+        }
+        return expired;
+    }
+
+    double getTime() const
+    {
+        return time;
+    }
+
+    Uint32 getTicks() const
+    {
+        // Wraps after 2^32 ticks, differences between two readings stay right
+        return (Uint32)timers.getNow();
+    }
+};
+
+// Where one frame sits on its sprite sheet, counted in cells
+struct FrameCell
+{
+    int column, row;
+};
+
+// How an animation is laid out on its sprite sheet, fixed when the game is compiled; only the sheet's size in pixels waits for the atlas
+struct SpriteClip
+{
+    int columns, rows; // Grid the sheet is cut into
+    int firstFrame, frameCount; // Cells played, in reading order, so an empty cell at the end is simply not counted
+    int trim; // Pixels cut off the bottom of each cell, rows are spaced by the trimmed height
+    float frameDuration; // Seconds per frame
+    bool loop; // Starts over after the last frame, otherwise stops there
+
+    constexpr FrameCell cell(int frame) const
+    {
+        return { (firstFrame + frame) % columns, (firstFrame + frame) / columns };
+    }
+
+    constexpr bool fitsSheet() const
+    {
+        return columns > 0 && rows > 0 && frameCount > 0 && firstFrame >= 0 && firstFrame + frameCount <= columns * rows;
+    }
+};
+
+// A clip together with the cell of every frame, worked out by the compiler
+template <size_t Count>
+struct ClipTable
+{
+    SpriteClip clip;
+    FrameCell cells[Count];
+};
+
+template <size_t... Frames>
+constexpr ClipTable<sizeof...(Frames)> makeClipTable(const SpriteClip& clip, index_sequence<Frames...>)
+{
+    return { clip, { clip.cell((int)Frames)... } };
+}
+
+// Every animation in the game
+constexpr SpriteClip WhiteBirdFlight = { 5, 3, 0, 14, 0, 0.1f, true }; // The last cell of the sheet is empty
+constexpr SpriteClip BlueBirdFlight = { 4, 2, 0, 8, 0, 0.1f, true };
+constexpr SpriteClip TurboBirdFlight = { 4, 1, 0, 4, 0, 0.1f, true };
+constexpr SpriteClip MonsterFlight = { 4, 1, 0, 4, 0, 0.1f, true };
+constexpr SpriteClip ShotgunFire = { 3, 2, 0, 6, 10, 0.1f, false };
+static_assert(WhiteBirdFlight.fitsSheet() && BlueBirdFlight.fitsSheet() && TurboBirdFlight.fitsSheet() && MonsterFlight.fitsSheet() && ShotgunFire.fitsSheet(),
+    "Every clip has to fit on its sprite sheet");
+
+constexpr auto WhiteBirdFrames = makeClipTable(WhiteBirdFlight, make_index_sequence<WhiteBirdFlight.frameCount>());
+constexpr auto BlueBirdFrames = makeClipTable(BlueBirdFlight, make_index_sequence<BlueBirdFlight.frameCount>());
+constexpr auto TurboBirdFrames = makeClipTable(TurboBirdFlight, make_index_sequence<TurboBirdFlight.frameCount>());
+constexpr auto MonsterFrames = makeClipTable(MonsterFlight, make_index_sequence<MonsterFlight.frameCount>());
+constexpr auto ShotgunFrames = makeClipTable(ShotgunFire, make_index_sequence<ShotgunFire.frameCount>());
+
+// A clip placed on its sheet in the atlas and shared by everything that plays it.
+// The texture rectangle of each frame is worked out once, so showing a frame is a table lookup.
+class AnimationClip
+{
+    SpriteClip clip;
+    const FrameCell* cells; // The clip's table, which lives as long as the program
+    vector<IntRect> frames; // Texture rectangle of each frame
+    Vector2i frameSize;
+
+public:
+    AnimationClip()
+    {
+        clip = SpriteClip();
+        cells = nullptr;
+        frames.assign(1, IntRect());
+    }
+
+    template <size_t Count>
+    explicit AnimationClip(const ClipTable<Count>& table) : clip(table.clip), cells(table.cells)
+    {
+        place(IntRect());
+    }
+
+    void place(const IntRect& sheetRegion)
+    {
+        // Called once the sheet has a place in the atlas
+        frames.assign(1, IntRect());
+        if (!cells)
+        {
+            return;
+        }
+        frameSize = Vector2i(sheetRegion.width / clip.columns, sheetRegion.height / clip.rows - clip.trim);
+        frames.resize(clip.frameCount);
+        for (int i = 0; i < clip.frameCount; i++)
+        {
+            frames[i] = IntRect(sheetRegion.left + cells[i].column * frameSize.x, sheetRegion.top + cells[i].row * frameSize.y, frameSize.x, frameSize.y);
+        }
+    }
+
+    int getFrameCount() const
+    {
+        return (int)frames.size();
+    }
+
+    const IntRect& getFrame(int frame) const
+    {
+        return frames[frame];
+    }
+
+    Vector2i getFrameSize() const
+    {
+        return frameSize;
+    }
+
+    float getFrameDuration() const
+    {
+        return clip.frameDuration;
+    }
+
+    int frameAt(Uint32 ticks, Uint32 ticksPerFrame) const
+    {
+        // Frame showing a number of ticks after the clip started
+        Uint32 step = ticks / ticksPerFrame;
+        return (int)(clip.loop ? step % frames.size() : min((size_t)step, frames.size() - 1));
+    }
+
+    bool isFinished(Uint32 ticks, Uint32 ticksPerFrame) const
+    {
+        return !clip.loop && ticks / ticksPerFrame >= frames.size();
+    }
+};
+
+enum BirdTypeId
+{
+    WhiteBirdType,
+    BlueBirdType,
+    TurboBirdType,
+    MonsterBirdType,
+    BirdTypeCount
+};
+
+enum MovementKind
+{
+    StraightMovement, // Flies in a straight horizontal line
+    WaveMovement // Follows its flight path while flying across
+};
+
+// Shape of the vertical part of a flight path, the horizontal part is always a straight crossing
+enum PathKind
+{
+    LinearPath, // Level flight
+    SinePath, // Smooth waves
+    ZigZagPath, // Straight climbs and drops
+    SwoopPath, // A deep swoop then a shallow one, a Catmull-Rom curve
+    DivePath, // A sharp dive and climb back
+    PathKindCount
+};
+
+const char* const PathNames[PathKindCount] = { "linear", "sine", "zigzag", "swoop", "dive" }; // As written in Waves.txt
+
+// Steepest climb of each shape, relative to a sine wave of the same amplitude
+const float PathSpeedFactor[PathKindCount] = { 0.0f, 1.0f, 0.64f, 1.84f, 1.28f };
+
+// One cubic piece of a curve, c[0] + c[1] t + c[2] t^2 + c[3] t^3 for t from 0 to 1
+struct CubicSegment
+{
+    float c[4];
+};
+
+constexpr CubicSegment catmullRomSegment(float p0, float p1, float p2, float p3)
+{
+    // The piece from p1 to p2
+    return { { p1, 0.5f * (p2 - p0), 0.5f * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3), 0.5f * (3.0f * p1 - p0 - 3.0f * p2 + p3) } };
+}
+
+// The swoop passes through heights 0, 2, 0.5 and 1.5 and repeats, in the same 0 to 2 range as the other shapes
+constexpr CubicSegment SwoopCurve[4] = {
+    catmullRomSegment(1.5f, 0.0f, 2.0f, 0.5f),
+    catmullRomSegment(0.0f, 2.0f, 0.5f, 1.5f),
+    catmullRomSegment(2.0f, 0.5f, 1.5f, 0.0f),
+    catmullRomSegment(0.5f, 1.5f, 0.0f, 2.0f)
+};
+
+// Flight path inputs and outputs of a flock, pointers into its arrays. Every path is a closed-form function of where
+// the bird started and how long it has flown, so positions never depend on the ticks before.
+struct FlightPaths
+{
+    const int* kind; // PathKind
+    const float* startX; // Where the bird entered the screen
+    const float* startY;
+    const float* velX; // Horizontal velocity (pixels per second)
+    const float* flightTime; // Seconds since it entered
+    const float* pathTime; // Seconds spent following its path, stands still during straight flight
+    const float* phaseRate; // Turns of the path shape per second of path time
+    const float* scale; // Pixels per unit of the shape
+    float* x; // Results
+    float* y;
+};
+
+inline float cosTurns(float u)
+{
+    // cos(2 pi u) for u from 0 to 1: a parabola refined once, within 0.0011.
+    // The SIMD kernels repeat these exact steps, with no fused multiply-add, so every kernel gives the same bits on every machine.
+    float x = u + 0.25f;
+    x = x - (x >= 0.5f ? 1.0f : 0.0f);
+    float y = 8.0f * x - 16.0f * x * fabs(x);
+    return 0.225f * (y * fabs(y) - y) + y;
+}
+
+void evaluatePathsScalar(const FlightPaths& paths, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        paths.x[i] = paths.startX[i] + paths.velX[i] * paths.flightTime[i];
+
+        // Position within one turn of the shape, every shape runs from 0 to 2
+        float u = paths.pathTime[i] * paths.phaseRate[i];
+        u = u - (float)(int)u;
+        float sine = 1.0f - cosTurns(u);
+        float zigzag = 2.0f - 2.0f * fabs(2.0f * u - 1.0f);
+        float segment = (float)(int)(u * 4.0f);
+        float t = u * 4.0f - segment;
+        const float* c = SwoopCurve[(int)segment].c;
+        float swoop = ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+        float dive = 8.0f * u * (1.0f - u);
+
+        int kind = paths.kind[i];
+        float shape = kind == SinePath ? sine : kind == ZigZagPath ? zigzag : kind == SwoopPath ? swoop : kind == DivePath ? dive : 0.0f;
+        paths.y[i] = paths.startY[i] + paths.scale[i] * shape;
+    }
+}
+
+#if defined(PATHS_SSE2)
+void evaluatePaths4(const FlightPaths& paths, size_t i)
+{
+    // Four birds at once, the same steps as evaluatePathsScalar
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 four = _mm_set1_ps(4.0f);
+
+    __m128 x = _mm_add_ps(_mm_loadu_ps(paths.startX + i), _mm_mul_ps(_mm_loadu_ps(paths.velX + i), _mm_loadu_ps(paths.flightTime + i)));
+    _mm_storeu_ps(paths.x + i, x);
+
+    __m128 u = _mm_mul_ps(_mm_loadu_ps(paths.pathTime + i), _mm_loadu_ps(paths.phaseRate + i));
+    u = _mm_sub_ps(u, _mm_cvtepi32_ps(_mm_cvttps_epi32(u)));
+
+    __m128 c = _mm_add_ps(u, _mm_set1_ps(0.25f));
+    c = _mm_sub_ps(c, _mm_and_ps(_mm_cmpge_ps(c, _mm_set1_ps(0.5f)), one));
+    __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(8.0f), c), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(16.0f), c), _mm_andnot_ps(signBit, c)));
+    s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.225f), _mm_sub_ps(_mm_mul_ps(s, _mm_andnot_ps(signBit, s)), s)), s);
+    __m128 sine = _mm_sub_ps(one, s);
+
+    __m128 zigzag = _mm_sub_ps(two, _mm_mul_ps(two, _mm_andnot_ps(signBit, _mm_sub_ps(_mm_mul_ps(two, u), one))));
+
+    __m128 segment = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(u, four)));
+    __m128 t = _mm_sub_ps(_mm_mul_ps(u, four), segment);
+    __m128 pieces[4];
+    for (int piece = 0; piece < 4; piece++)
+    {
+        pieces[piece] = _mm_cmpeq_ps(segment, _mm_set1_ps((float)piece));
+    }
+    __m128 coefficients[4];
+    for (int k = 0; k < 4; k++)
+    {
+        // Each lane keeps the coefficient of its own piece, or-ing four masked values keeps the dependency chains short
+        coefficients[k] = _mm_or_ps(_mm_or_ps(_mm_and_ps(pieces[0], _mm_set1_ps(SwoopCurve[0].c[k])), _mm_and_ps(pieces[1], _mm_set1_ps(SwoopCurve[1].c[k]))),
+            _mm_or_ps(_mm_and_ps(pieces[2], _mm_set1_ps(SwoopCurve[2].c[k])), _mm_and_ps(pieces[3], _mm_set1_ps(SwoopCurve[3].c[k]))));
+    }
+    __m128 swoop = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(coefficients[3], t), coefficients[2]), t), coefficients[1]), t), coefficients[0]);
+    __m128 dive = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(8.0f), u), _mm_sub_ps(one, u));
+
+    __m128i kind = _mm_loadu_si128((const __m128i*)(paths.kind + i));
+    sine = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(kind, _mm_set1_epi32(SinePath))), sine);
+    zigzag = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(kind, _mm_set1_epi32(ZigZagPath))), zigzag);
+    swoop = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(kind, _mm_set1_epi32(SwoopPath))), swoop);
+    dive = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(kind, _mm_set1_epi32(DivePath))), dive);
+    __m128 shape = _mm_or_ps(_mm_or_ps(sine, zigzag), _mm_or_ps(swoop, dive)); // Linear lanes are left at 0
+    _mm_storeu_ps(paths.y + i, _mm_add_ps(_mm_loadu_ps(paths.startY + i), _mm_mul_ps(_mm_loadu_ps(paths.scale + i), shape)));
+}
+#endif
+
+#if defined(PATHS_AVX2)
+void evaluatePaths8(const FlightPaths& paths, size_t i)
+{
+    // Eight birds at once, the same steps as evaluatePathsScalar
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 four = _mm256_set1_ps(4.0f);
+
+    __m256 x = _mm256_add_ps(_mm256_loadu_ps(paths.startX + i), _mm256_mul_ps(_mm256_loadu_ps(paths.velX + i), _mm256_loadu_ps(paths.flightTime + i)));
+    _mm256_storeu_ps(paths.x + i, x);
+
+    __m256 u = _mm256_mul_ps(_mm256_loadu_ps(paths.pathTime + i), _mm256_loadu_ps(paths.phaseRate + i));
+    u = _mm256_sub_ps(u, _mm256_cvtepi32_ps(_mm256_cvttps_epi32(u)));
+
+    __m256 c = _mm256_add_ps(u, _mm256_set1_ps(0.25f));
+    c = _mm256_sub_ps(c, _mm256_and_ps(_mm256_cmp_ps(c, _mm256_set1_ps(0.5f), _CMP_GE_OQ), one));
+    __m256 s = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(8.0f), c), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(16.0f), c), _mm256_andnot_ps(signBit, c)));
+    s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(0.225f), _mm256_sub_ps(_mm256_mul_ps(s, _mm256_andnot_ps(signBit, s)), s)), s);
+    __m256 sine = _mm256_sub_ps(one, s);
+
+    __m256 zigzag = _mm256_sub_ps(two, _mm256_mul_ps(two, _mm256_andnot_ps(signBit, _mm256_sub_ps(_mm256_mul_ps(two, u), one))));
+
+    __m256 scaled = _mm256_mul_ps(u, four);
+    __m256i piece = _mm256_cvttps_epi32(scaled);
+    __m256 t = _mm256_sub_ps(scaled, _mm256_cvtepi32_ps(piece));
+    __m256 coefficients[4];
+    for (int k = 0; k < 4; k++)
+    {
+        // Each piece's coefficient, looked up by the piece number
+        coefficients[k] = _mm256_permutevar8x32_ps(_mm256_setr_ps(SwoopCurve[0].c[k], SwoopCurve[1].c[k], SwoopCurve[2].c[k], SwoopCurve[3].c[k], 0.0f, 0.0f, 0.0f, 0.0f), piece);
+    }
+    __m256 swoop = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(coefficients[3], t), coefficients[2]), t), coefficients[1]), t), coefficients[0]);
+    __m256 dive = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(8.0f), u), _mm256_sub_ps(one, u));
+
+    __m256i kind = _mm256_loadu_si256((const __m256i*)(paths.kind + i));
+    __m256 shape = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(kind, _mm256_set1_epi32(SinePath))), sine);
+    shape = _mm256_blendv_ps(shape, zigzag, _mm256_castsi256_ps(_mm256_cmpeq_epi32(kind, _mm256_set1_epi32(ZigZagPath))));
+    shape = _mm256_blendv_ps(shape, swoop, _mm256_castsi256_ps(_mm256_cmpeq_epi32(kind, _mm256_set1_epi32(SwoopPath))));
+    shape = _mm256_blendv_ps(shape, dive, _mm256_castsi256_ps(_mm256_cmpeq_epi32(kind, _mm256_set1_epi32(DivePath))));
+    _mm256_storeu_ps(paths.y + i, _mm256_add_ps(_mm256_loadu_ps(paths.startY + i), _mm256_mul_ps(_mm256_loadu_ps(paths.scale + i), shape)));
+}
+#endif
+
+const char* getPathKernelName()
+{
+#if defined(PATHS_AVX2)
+    return "AVX2";
+#elif defined(PATHS_SSE2)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
+
+void evaluatePaths(const FlightPaths& paths, size_t count)
+{
+    // The widest kernel the build targets, the scalar one for what is left over
+    size_t i = 0;
+#if defined(PATHS_AVX2)
+    for (; i + 8 <= count; i += 8)
+    {
+        evaluatePaths8(paths, i);
+    }
+#elif defined(PATHS_SSE2)
+    for (; i + 4 <= count; i += 4)
+    {
+        evaluatePaths4(paths, i);
+    }
+#endif
+    evaluatePathsScalar(paths, i, count);
+}
+
+// Everything that is the same for every bird of one kind
+struct BirdType
+{
+    const Texture* texture; // Texture holding the sprite sheet
+    IntRect sheetRegion; // Area of the texture holding the sprite sheet
+    AnimationClip flight; // Flying animation, shared by every bird of this kind
+    int frameWidth, frameHeight; // Dimensions of a single frame
+
+    float speed; // Horizontal speed (pixels per second)
+    float amplitude; // Vertical speed at the peak of a sine path (pixels per second), with the frequency it sets the height of every path
+    float frequency; // Radians of the path per second
+    int path; // PathKind, birds with a path switch between following it and straight flight
+    int points; // Score for hitting the bird
+    int spawnBand; // Birds spawn in the top 1/spawnBand of the window
+    vector<HitMask> frameMasks; // Solid pixels of each animation frame, empty to hit the whole frame
+
+    BirdType()
+    {
+        texture = nullptr;
+        frameWidth = frameHeight = 0;
+        speed = 0.0f;
+        amplitude = 0.0f;
+        frequency = 0.0f;
+        path = LinearPath;
+        points = 0;
+        spawnBand = 3;
+    }
+
+    template <size_t Count>
+    BirdType(const Texture& sheetTexture, const IntRect& region, const ClipTable<Count>& flightClip) : flight(flightClip)
+    {
+        texture = &sheetTexture;
+        sheetRegion = region;
+
+        // Set up texture properties
+        flight.place(sheetRegion);
+        frameWidth = flight.getFrameSize().x;
+        frameHeight = flight.getFrameSize().y;
+
+        speed = 0.0f;
+        amplitude = 0.0f;
+        frequency = 0.0f;
+        path = LinearPath;
+        points = 0;
+        spawnBand = 3;
+    }
+
+    void setHitMask(const HitMask& sheetMask)
+    {
+        // Cut the sprite sheet mask into one mask per frame
+        frameMasks.clear();
+        if (sheetMask.empty())
+        {
+            return;
+        }
+        for (int frame = 0; frame < flight.getFrameCount(); frame++)
+        {
+            IntRect frameArea = flight.getFrame(frame);
+            frameArea.left -= sheetRegion.left;
+            frameArea.top -= sheetRegion.top;
+            frameMasks.push_back(HitMask(sheetMask, frameArea));
+        }
+    }
+};
+
+// One bird as the renderer needs it, copied out of the simulation so it can be drawn while the next tick runs
+struct BirdSprite
+{
+    const Texture* texture;
+    IntRect textureRect; // Current animation frame
+    FloatRect previous, current; // Bounds at the last two ticks, blended when drawn
+    bool flipped; // Flying left
+};
+
+void drawBirdSprites(SpriteBatch& batch, const vector<BirdSprite>& sprites, float alpha)
+{
+    for (size_t i = 0; i < sprites.size(); i++)
+    {
+        const BirdSprite& sprite = sprites[i];
+        FloatRect bounds = sprite.current;
+        bounds.left = sprite.previous.left + (sprite.current.left - sprite.previous.left) * alpha;
+        bounds.top = sprite.previous.top + (sprite.current.top - sprite.previous.top) * alpha;
+        batch.drawQuad(*sprite.texture, bounds, sprite.textureRect, sprite.flipped);
+    }
+}
+
+// Struct-of-arrays storage for every bird in a scene, updated one field at a time in tight loops
+class BirdStore
+{
+    const vector<BirdType>& types;
+
+public:
+    vector<unsigned char> typeId; // Index into the bird type table
+    vector<float> posX, posY; // Sprite position
+    vector<float> prevX, prevY; // Sprite position at the previous simulation tick, for interpolated drawing
+    vector<float> velX; // Horizontal velocity (pixels per second), negative when flying left
+    vector<unsigned char> movement; // Current MovementKind
+    vector<int> path; // PathKind
+    vector<float> startX, startY; // Where the bird entered the screen, its position is worked out from here
+    vector<float> flightTime; // Seconds since the bird entered
+    vector<float> pathTime; // Seconds spent following the path
+    vector<float> phaseRate; // Turns of the path shape per second
+    vector<float> pathScale; // Pixels per unit of the path shape
+    vector<int> frame; // Current animation frame, worked out from the clip by animate()
+    vector<Uint32> clipStart; // Clock tick the bird's flight clip started on
+    vector<int> points; // Score for hitting the bird
+    vector<unsigned char> ready; // Whether the bird can be hit, false while it cools down
+    size_t count; // Number of live birds
+
+    Random random; // Spawn heights and directions
+    GameClock* clock; // Times the animations and ends the hit cooldowns, without one birds keep their first frame and can always be hit
+    vector<Uint32> ticksPerFrame; // Of each bird type's flight clip on the clock
+
+    BirdStore(const vector<BirdType>& birdTypes, Uint32 seed = 1) : types(birdTypes), random(seed)
+    {
+        count = 0;
+        clock = nullptr;
+    }
+
+    void setClock(GameClock* birdClock)
+    {
+        // The clock is reset along with the store, that drops the timers of the old birds
+        clock = birdClock;
+        ticksPerFrame.clear();
+        for (size_t i = 0; clock && i < types.size(); i++)
+        {
+            ticksPerFrame.push_back(clock->ticksFor(types[i].flight.getFrameDuration()));
+        }
+    }
+
+    void reserve(size_t capacity)
+    {
+        typeId.reserve(capacity);
+        posX.reserve(capacity);
+        posY.reserve(capacity);
+        prevX.reserve(capacity);
+        prevY.reserve(capacity);
+        velX.reserve(capacity);
+        movement.reserve(capacity);
+        path.reserve(capacity);
+        startX.reserve(capacity);
+        startY.reserve(capacity);
+        flightTime.reserve(capacity);
+        pathTime.reserve(capacity);
+        phaseRate.reserve(capacity);
+        pathScale.reserve(capacity);
+        frame.reserve(capacity);
+        clipStart.reserve(capacity);
+        points.reserve(capacity);
+        ready.reserve(capacity);
+    }
+
+    void clear()
+    {
+        typeId.clear();
+        posX.clear();
+        posY.clear();
+        prevX.clear();
+        prevY.clear();
+        velX.clear();
+        movement.clear();
+        path.clear();
+        startX.clear();
+        startY.clear();
+        flightTime.clear();
+        pathTime.clear();
+        phaseRate.clear();
+        pathScale.clear();
+        frame.clear();
+        clipStart.clear();
+        points.clear();
+        ready.clear();
+        count = 0;
+    }
+
+    size_t spawn(int type, const Vector2u& windowSize, float initialCooldown, float speed = 0.0f, float waveAmplitude = 0.0f, float waveFrequency = 0.0f,
+        int pathKind = -1)
+    {
+        // Flight overrides of 0, and a path of -1, keep the bird type's own
+        const BirdType& birdType = types[type];
+        float amplitude = waveAmplitude > 0.0f ? waveAmplitude : birdType.amplitude;
+        float frequency = waveFrequency > 0.0f ? waveFrequency : birdType.frequency;
+        int kind = pathKind >= 0 && pathKind < PathKindCount ? pathKind : birdType.path;
+        typeId.push_back((unsigned char)type);
+        posX.push_back(0.0f);
+        posY.push_back(0.0f);
+        prevX.push_back(0.0f);
+        prevY.push_back(0.0f);
+        velX.push_back(speed > 0.0f ? speed : birdType.speed);
+        movement.push_back(kind != LinearPath ? WaveMovement : StraightMovement);
+        path.push_back(kind);
+        startX.push_back(0.0f);
+        startY.push_back(0.0f);
+        flightTime.push_back(0.0f);
+        pathTime.push_back(0.0f);
+        phaseRate.push_back(frequency / 6.28318531f);
+        pathScale.push_back(frequency > 0.0f ? amplitude / frequency : 0.0f); // A sine path climbs at most at the amplitude
+        frame.push_back(0);
+        clipStart.push_back(clock ? clock->getTicks() : 0);
+        points.push_back(birdType.points);
+        ready.push_back(1);
+        count++;
+
+        size_t i = count - 1;
+        randomizeStart(i, windowSize);
+        startCooldown(i, initialCooldown);
+        return i;
+    }
+
+    void startCooldown(size_t i, float seconds)
+    {
+        if (clock && seconds > 0.0f)
+        {
+            ready[i] = 0;
+            clock->start(BirdReadyTimer, (Uint32)i, seconds);
+        }
+    }
+
+    bool handleTimer(const TimerEvent& event)
+    {
+        // False when the timer is not a bird's
+        if (event.kind == BirdReadyTimer)
+        {
+            ready[event.data] = 1;
+            return true;
+        }
+        return false;
+    }
+
+    void randomizeStart(size_t i, const Vector2u& windowSize)
+    {
+        const BirdType& birdType = types[typeId[i]];
+        float width = birdType.frameWidth * 0.5f;
+
+        // Randomly choose a vertical position
+        posY[i] = random.nextInt(windowSize.y / birdType.spawnBand);
+
+        // Randomly choose direction (0 = left to right, 1 = right to left), keeping the speed the bird spawned with
+        float speed = fabs(velX[i]);
+        bool goingRight = random.nextInt(2);
+        if (goingRight)
+        {
+            posX[i] = -width; // Start just off the left
+            velX[i] = speed; // Moving right
+        }
+        else
+        {
+            posX[i] = windowSize.x + 50; // Start just off the right
+            velX[i] = -speed; // Moving left, the sprite is drawn flipped
+        }
+
+        // The path starts over from here
+        startX[i] = posX[i];
+        startY[i] = posY[i];
+        flightTime[i] = 0.0f;
+        pathTime[i] = 0.0f;
+
+        // Respawning is a jump, not movement, so don't interpolate across the screen
+        prevX[i] = posX[i];
+        prevY[i] = posY[i];
+    }
+
+    void toggleMovementMode()
+    {
+        // Toggle between following the path and straight movement for every bird that has a path
+        for (size_t i = 0; i < count; i++)
+        {
+            if (path[i] != LinearPath)
+            {
+                movement[i] = movement[i] == WaveMovement ? StraightMovement : WaveMovement;
+            }
+        }
+    }
+
+    void update(float deltaTime, const Vector2u& windowSize)
+    {
+        // Remember where every bird was so drawing can blend between ticks
+        prevX = posX;
+        prevY = posY;
+
+        // Path time stands still during straight flight, which keeps the bird at its height
+        for (size_t i = 0; i < count; i++)
+        {
+            flightTime[i] += deltaTime;
+            pathTime[i] += movement[i] == WaveMovement ? deltaTime : 0.0f;
+        }
+
+        // Every position straight from the path
+        evaluatePaths(getFlightPaths(), count);
+
+        // Reset birds that went off-screen
+        for (size_t i = 0; i < count; i++)
+        {
+            float width = types[typeId[i]].frameWidth * 0.5f;
+            if ((velX[i] > 0.0f && posX[i] > windowSize.x) || (velX[i] < 0.0f && posX[i] < -width))
+            {
+                randomizeStart(i, windowSize);
+            }
+        }
+    }
+
+    FlightPaths getFlightPaths()
+    {
+        FlightPaths paths = { path.data(), startX.data(), startY.data(), velX.data(), flightTime.data(), pathTime.data(), phaseRate.data(),
+            pathScale.data(), posX.data(), posY.data() };
+        return paths;
+    }
+
+    FloatRect getBounds(size_t i) const
+    {
+        return getBounds(i, posX[i], posY[i]);
+    }
+
+    FloatRect getBounds(size_t i, float x, float y) const
+    {
+        // Same area as the sprite's global bounds, a flipped sprite extends to the left of its position
+        const BirdType& birdType = types[typeId[i]];
+        float width = birdType.frameWidth * 0.5f;
+        float height = birdType.frameHeight * 0.5f;
+        float left = velX[i] < 0.0f ? x - width : x;
+        return FloatRect(left, y, width, height);
+    }
+
+    bool hitTest(size_t i, float x, float y) const
+    {
+        return hitTestAt(i, x, y, posX[i], posY[i], frame[i]);
+    }
+
+    bool hitTestAt(size_t i, float x, float y, float birdX, float birdY, int birdFrame) const
+    {
+        // Same as hitTest, with the bird placed and posed as it was at some earlier time
+        // Cheap bounds test first, then the one bit of the frame mask under the point
+        FloatRect bounds = getBounds(i, birdX, birdY);
+        if (!bounds.contains(x, y))
+        {
+            return false;
+        }
+        const BirdType& birdType = types[typeId[i]];
+        if (birdType.frameMasks.empty())
+        {
+            return true;
+        }
+
+        // Map the point into the unscaled frame, mirrored when the sprite is flipped to fly left
+        int frameX = (int)((x - bounds.left) * birdType.frameWidth / bounds.width);
+        int frameY = (int)((y - bounds.top) * birdType.frameHeight / bounds.height);
+        if (velX[i] < 0.0f)
+        {
+            frameX = birdType.frameWidth - 1 - frameX;
+        }
+        return birdType.frameMasks[birdFrame].test(frameX, frameY);
+    }
+
+    void animate()
+    {
+        // Every bird's frame from its clip and start tick in one pass, nothing is stepped per bird
+        if (!clock)
+        {
+            return;
+        }
+        Uint32 now = clock->getTicks();
+        for (size_t i = 0; i < count; i++)
+        {
+            frame[i] = types[typeId[i]].flight.frameAt(now - clipStart[i], ticksPerFrame[typeId[i]]);
+        }
+    }
+
+    const IntRect& getFrameRect(size_t i) const
+    {
+        return types[typeId[i]].flight.getFrame(frame[i]);
+    }
+
+    void capture(vector<BirdSprite>& sprites) const
+    {
+        // Resized in place, so a reused snapshot stops allocating once it has seen the most birds
+        sprites.resize(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            sprites[i].texture = types[typeId[i]].texture;
+            sprites[i].textureRect = getFrameRect(i);
+            sprites[i].previous = getBounds(i, prevX[i], prevY[i]);
+            sprites[i].current = getBounds(i, posX[i], posY[i]);
+            sprites[i].flipped = velX[i] < 0.0f;
+        }
+    }
+
+    void draw(SpriteBatch& batch, float alpha) const
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            // Blend between the last two simulation ticks
+            float x = prevX[i] + (posX[i] - prevX[i]) * alpha;
+            float y = prevY[i] + (posY[i] - prevY[i]) * alpha;
+
+            // Flip horizontally when flying left
+            batch.drawQuad(*types[typeId[i]].texture, getBounds(i, x, y), getFrameRect(i), velX[i] < 0.0f);
+        }
+    }
+};
+
+// Uniform grid over bird bounds, hashed so birds off the edge of the window still land in a bucket
+class SpatialHash
+{
+    float cellSize; // Width and height of one grid cell in pixels
+    vector<vector<unsigned>> buckets; // Bird indices overlapping each hashed cell
+    vector<IntRect> cellRanges; // First cell and cell count each bird is currently stored under
+    vector<unsigned> queryStamp; // Last query that returned each bird, to skip duplicates in area queries
+    unsigned currentQuery;
+    size_t count; // Number of birds stored
+
+    size_t bucketIndex(int cellX, int cellY) const
+    {
+        // Bucket count is a power of two, so masking replaces the modulo
+        unsigned hash = (unsigned)cellX * 73856093u ^ (unsigned)cellY * 19349663u;
+        return hash & (buckets.size() - 1);
+    }
+
+    IntRect cellsCovering(const FloatRect& area) const
+    {
+        int left = (int)floor(area.left / cellSize);
+        int top = (int)floor(area.top / cellSize);
+        int right = (int)floor((area.left + area.width) / cellSize);
+        int bottom = (int)floor((area.top + area.height) / cellSize);
+        return IntRect(left, top, right - left + 1, bottom - top + 1);
+    }
+
+    void insert(unsigned bird, const IntRect& cells)
+    {
+        for (int y = cells.top; y < cells.top + cells.height; y++)
+        {
+            for (int x = cells.left; x < cells.left + cells.width; x++)
+            {
+                buckets[bucketIndex(x, y)].push_back(bird);
+            }
+        }
+    }
+
+    void remove(unsigned bird, const IntRect& cells)
+    {
+        for (int y = cells.top; y < cells.top + cells.height; y++)
+        {
+            for (int x = cells.left; x < cells.left + cells.width; x++)
+            {
+                // Buckets are unordered, so swap the last entry into the hole
+                vector<unsigned>& bucket = buckets[bucketIndex(x, y)];
+                for (size_t i = 0; i < bucket.size(); i++)
+                {
+                    if (bucket[i] == bird)
+                    {
+                        bucket[i] = bucket.back();
+                        bucket.pop_back();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    void grow(size_t birdCount)
+    {
+        // Keep about one bird per bucket or fewer, so a point query stays constant time as the flock grows
+        if (birdCount <= buckets.size())
+        {
+            return;
+        }
+        size_t size = buckets.size();
+        while (size < birdCount)
+        {
+            size *= 2;
+        }
+        buckets.assign(size, vector<unsigned>());
+        for (size_t i = 0; i < count; i++)
+        {
+            insert((unsigned)i, cellRanges[i]);
+        }
+    }
+
+public:
+    SpatialHash(float cellSize = 128.0f, size_t bucketCount = 1024) : cellSize(cellSize)
+    {
+        // Round the bucket count up to a power of two
+        size_t size = 1;
+        while (size < bucketCount)
+        {
+            size *= 2;
+        }
+        buckets.resize(size);
+        currentQuery = 0;
+        count = 0;
+    }
+
+    void reserve(size_t capacity)
+    {
+        // Sized for the most birds up front, so spawning never rehashes mid-game
+        grow(capacity);
+        cellRanges.reserve(capacity);
+        queryStamp.reserve(capacity);
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            buckets[i].clear();
+        }
+        cellRanges.clear();
+        queryStamp.clear();
+        count = 0;
+    }
+
+    void update(const BirdStore& birds)
+    {
+        // Birds are only ever added or all cleared, so a shorter store means it was reset
+        if (birds.count < count)
+        {
+            clear();
+        }
+
+        // Only birds that crossed into another cell touch the buckets
+        for (size_t i = 0; i < count; i++)
+        {
+            IntRect cells = cellsCovering(birds.getBounds(i));
+            if (cells != cellRanges[i])
+            {
+                remove((unsigned)i, cellRanges[i]);
+                insert((unsigned)i, cells);
+                cellRanges[i] = cells;
+            }
+        }
+
+        grow(birds.count);
+
+        // Newly spawned birds
+        for (size_t i = count; i < birds.count; i++)
+        {
+            IntRect cells = cellsCovering(birds.getBounds(i));
+            insert((unsigned)i, cells);
+            cellRanges.push_back(cells);
+            queryStamp.push_back(0);
+        }
+        count = birds.count;
+    }
+
+    void queryPoint(float x, float y, vector<size_t>& candidates) const
+    {
+        // Every bird whose bounds might contain the point, plus the odd one sharing the bucket
+        candidates.clear();
+        const vector<unsigned>& bucket = buckets[bucketIndex((int)floor(x / cellSize), (int)floor(y / cellSize))];
+        candidates.assign(bucket.begin(), bucket.end());
+    }
+
+    void queryArea(const FloatRect& area, vector<size_t>& candidates)
+    {
+        // Every bird whose bounds might overlap the area, each listed once
+        candidates.clear();
+        currentQuery++;
+        IntRect cells = cellsCovering(area);
+        for (int y = cells.top; y < cells.top + cells.height; y++)
+        {
+            for (int x = cells.left; x < cells.left + cells.width; x++)
+            {
+                const vector<unsigned>& bucket = buckets[bucketIndex(x, y)];
+                for (size_t i = 0; i < bucket.size(); i++)
+                {
+                    if (queryStamp[bucket[i]] != currentQuery)
+                    {
+                        queryStamp[bucket[i]] = currentQuery;
+                        candidates.push_back(bucket[i]);
+                    }
+                }
+            }
+        }
+    }
+};
+
+void makeBirdTypes(vector<BirdType>& types, const AssetManager& assets)
+{
+    const Texture& atlas = assets.getAtlas();
+    types.assign(BirdTypeCount, BirdType());
+
+    types[WhiteBirdType] = BirdType(atlas, assets.getRegion("Textures/flappy bird white.png"), WhiteBirdFrames);
+    types[WhiteBirdType].setHitMask(assets.getHitMask("Textures/flappy bird white.png"));
+    types[WhiteBirdType].speed = 180.0f; // 3 pixels per frame at 60 FPS
+    types[WhiteBirdType].points = 1;
+
+    types[BlueBirdType] = BirdType(atlas, assets.getRegion("Textures/flappy bird blue.png"), BlueBirdFrames);
+    types[BlueBirdType].setHitMask(assets.getHitMask("Textures/flappy bird blue.png"));
+    types[BlueBirdType].speed = 240.0f; // 4 pixels per frame at 60 FPS
+    types[BlueBirdType].points = 2;
+
+    types[TurboBirdType] = BirdType(atlas, assets.getRegion("Textures/turbo bird.png"), TurboBirdFrames);
+    types[TurboBirdType].setHitMask(assets.getHitMask("Textures/turbo bird.png"));
+    types[TurboBirdType].speed = 300.0f;
+    types[TurboBirdType].amplitude = 420.0f; // 7 pixels per frame at 60 FPS
+    types[TurboBirdType].frequency = 10.0f;
+    types[TurboBirdType].path = SinePath;
+    types[TurboBirdType].points = 4;
+    types[TurboBirdType].spawnBand = 4;
+
+    types[MonsterBirdType] = BirdType(atlas, assets.getRegion("Textures/monster.png"), MonsterFrames);
+    types[MonsterBirdType].setHitMask(assets.getHitMask("Textures/monster.png"));
+    types[MonsterBirdType].speed = 200.0f;
+    types[MonsterBirdType].amplitude = 420.0f; // 7 pixels per frame at 60 FPS
+    types[MonsterBirdType].frequency = 5.0f;
+    types[MonsterBirdType].path = SinePath;
+    types[MonsterBirdType].points = 10;
+    types[MonsterBirdType].spawnBand = 4;
+}
+
+// One row of the wave table: which birds to send, how many, when, and how they fly
+struct SpawnRule
+{
+    int type; // BirdTypeId
+    int count; // Birds the wave sends in total
+    int minStreak; // Streak that starts the wave
+    int minScore; // Score that starts the wave, 0 for none (scores can go negative), both have to be reached
+    float delay; // Seconds from the trigger to the first bird
+    float interval; // Seconds between the wave's birds
+    float cooldown; // Seconds before a new bird can be hit
+    float speed, amplitude, frequency; // Flight overrides, 0 keeps the bird type's own
+    int path; // PathKind, -1 keeps the bird type's own
+};
+
+const char* const BirdTypeNames[BirdTypeCount] = { "white", "blue", "turbo", "monster" }; // As written in Waves.txt
+
+void makeDefaultWaves(vector<SpawnRule>& waves)
+{
+    // The original game: white and blue birds from the start, the turbo bird at a streak of 6 and the monster at 8
+    const SpawnRule rules[] = {
+        { WhiteBirdType, 1, 0, 0, 0.0f, 0.0f, 1.2f, 0.0f, 0.0f, 0.0f, -1 },
+        { BlueBirdType, 1, 0, 0, 0.0f, 0.0f, 1.2f, 0.0f, 0.0f, 0.0f, -1 },
+        { TurboBirdType, 1, 6, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1 },
+        { MonsterBirdType, 1, 8, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1 }
+    };
+    waves.assign(rules, rules + sizeof(rules) / sizeof(rules[0]));
+}
+
+void makeStressWaves(vector<SpawnRule>& waves, int birdCount)
+{
+    // Every kind of bird in overlapping waves a second apart, each arriving over two seconds, for the heaviest load a table can ask for.
+    // Each kind follows a different curved path so every path shape is evaluated.
+    waves.clear();
+    int perType = max(1, birdCount / BirdTypeCount);
+    for (int type = 0; type < BirdTypeCount; type++)
+    {
+        SpawnRule rule = { type, perType, 0, 0, (float)type, 2.0f / perType, 0.0f, 0.0f, 420.0f, 5.0f, 1 + type % (PathKindCount - 1) };
+        waves.push_back(rule);
+    }
+}
+
+bool loadWaves(vector<SpawnRule>& waves, const string& filePath)
+{
+    // One wave per line: bird count streak score delay interval cooldown [speed amplitude frequency [path]], # starts a comment
+    ifstream file(filePath);
+    if (!file.is_open())
+    {
+        return false;
+    }
+    vector<SpawnRule> loaded;
+    string line;
+    int lineNumber = 0;
+    while (getline(file, line))
+    {
+        lineNumber++;
+        istringstream in(line);
+        string name;
+        if (!(in >> name) || name[0] == '#')
+        {
+            continue;
+        }
+        SpawnRule rule = { BirdTypeCount, 0, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1 };
+        for (int i = 0; i < BirdTypeCount; i++)
+        {
+            if (name == BirdTypeNames[i])
+            {
+                rule.type = i;
+            }
+        }
+        in >> rule.count >> rule.minStreak >> rule.minScore >> rule.delay >> rule.interval >> rule.cooldown;
+        if (in.fail() || rule.type == BirdTypeCount || rule.count < 0 || rule.interval < 0.0f)
+        {
+            cout << filePath << " line " << lineNumber << ": not a wave: " << line << endl;
+            return false;
+        }
+        in >> rule.speed >> rule.amplitude >> rule.frequency; // Optional, missing ones read as 0
+        string pathName;
+        if (in >> pathName)
+        {
+            for (int i = 0; i < PathKindCount; i++)
+            {
+                if (pathName == PathNames[i])
+                {
+                    rule.path = i;
+                }
+            }
+            if (rule.path < 0)
+            {
+                cout << filePath << " line " << lineNumber << ": no path called " << pathName << endl;
+                return false;
+            }
+        }
+        loaded.push_back(rule);
+    }
+    waves.swap(loaded);
+    return true;
+}
+
+void loadWaveTable(vector<SpawnRule>& waves)
+{
+    // Waves.txt next to the game when it is there and valid, the built in table otherwise
+    if (!loadWaves(waves, "Waves.txt"))
+    {
+        makeDefaultWaves(waves);
+    }
+}
+
+// Sends each wave's birds into the flock as its trigger and timing allow.
+// Hit birds respawn rather than being removed, so the whole table never has more than getPoolSize() birds in flight.
+class WaveScheduler
+{
+    const vector<SpawnRule>& waves;
+    vector<double> startTimes; // Game time each wave was triggered, negative until then
+    vector<int> sent; // Birds each wave has sent so far
+
+public:
+    WaveScheduler(const vector<SpawnRule>& waveTable) : waves(waveTable)
+    {
+    }
+
+    size_t getPoolSize() const
+    {
+        size_t birds = 0;
+        for (size_t i = 0; i < waves.size(); i++)
+        {
+            birds += waves[i].count;
+        }
+        return birds;
+    }
+
+    float getMaxSpeed(const vector<BirdType>& types) const
+    {
+        // Horizontal speed plus the steepest its path can climb, with the table's overrides applied
+        float fastest = 0.0f;
+        for (size_t i = 0; i < waves.size(); i++)
+        {
+            const SpawnRule& rule = waves[i];
+            const BirdType& type = types[rule.type];
+            float climb = (rule.amplitude > 0.0f ? rule.amplitude : type.amplitude) * PathSpeedFactor[rule.path >= 0 ? rule.path : type.path];
+            fastest = max(fastest, (rule.speed > 0.0f ? rule.speed : type.speed) + climb);
+        }
+        return fastest;
+    }
+
+    void reset()
+    {
+        startTimes.assign(waves.size(), -1.0);
+        sent.assign(waves.size(), 0);
+    }
+
+    void update(double gameTime, int streak, int score, BirdStore& birds, const Vector2u& fieldSize)
+    {
+        // Game time comes from the simulation's clock
+        for (size_t i = 0; i < waves.size(); i++)
+        {
+            const SpawnRule& rule = waves[i];
+            if (startTimes[i] < 0.0)
+            {
+                // A wave starts once, and keeps going even if the streak is lost afterwards
+                if (streak < rule.minStreak || (rule.minScore > 0 && score < rule.minScore))
+                {
+                    continue;
+                }
+                startTimes[i] = gameTime;
+            }
+            while (sent[i] < rule.count && gameTime >= startTimes[i] + rule.delay + sent[i] * rule.interval)
+            {
+                birds.spawn(rule.type, fieldSize, rule.cooldown, rule.speed, rule.amplitude, rule.frequency, rule.path);
+                sent[i]++;
+            }
+        }
+    }
+};
+
+// Everything the player did during one simulation tick
+struct TickInput
+{
+    Vector2i mouse; // Cursor position inside the window
+    bool click; // Left button pressed since the last tick
+    bool tabToggle; // Tab pressed since the last tick
+    Vector2i clickPosition; // Where the button went down
+    float clickAge; // How long before the start of this tick the click happened (seconds)
+};
+
+// Bird positions over the last few ticks, so a shot can be judged against what was on screen when it was fired
+class BirdHistory
+{
+    enum
+    {
+        Length = 32 // Ticks kept, a little over a quarter of a second at 120 Hz
+    };
+
+    struct Snapshot
+    {
+        vector<float> x, y;
+        vector<int> frame;
+    };
+
+    Snapshot snapshots[Length];
+    size_t newest; // Slot of the latest snapshot
+    size_t stored; // Snapshots recorded since the last clear, up to Length
+
+public:
+    BirdHistory()
+    {
+        clear();
+    }
+
+    void reserve(size_t capacity)
+    {
+        for (size_t i = 0; i < Length; i++)
+        {
+            snapshots[i].x.reserve(capacity);
+            snapshots[i].y.reserve(capacity);
+            snapshots[i].frame.reserve(capacity);
+        }
+    }
+
+    void clear()
+    {
+        newest = 0;
+        stored = 0;
+    }
+
+    void record(const BirdStore& birds)
+    {
+        // Reuses the slot's vectors, so a steady game never allocates here
+        newest = (newest + 1) % Length;
+        Snapshot& snapshot = snapshots[newest];
+        snapshot.x.assign(birds.posX.begin(), birds.posX.begin() + birds.count);
+        snapshot.y.assign(birds.posY.begin(), birds.posY.begin() + birds.count);
+        snapshot.frame.assign(birds.frame.begin(), birds.frame.begin() + birds.count);
+        stored = min(stored + 1, (size_t)Length);
+    }
+
+    float getMaxTicksAgo() const
+    {
+        return stored > 1 ? (float)(stored - 1) : 0.0f;
+    }
+
+    bool lookup(size_t bird, float ticksAgo, float& x, float& y, int& frame) const
+    {
+        // Blend the two snapshots around the requested time, false if the bird did not exist yet
+        if (stored == 0)
+        {
+            return false;
+        }
+        ticksAgo = max(0.0f, min(ticksAgo, getMaxTicksAgo()));
+        size_t older = (size_t)ticksAgo;
+        float blend = ticksAgo - older;
+        const Snapshot& a = snapshots[(newest + Length - older) % Length];
+        const Snapshot& b = snapshots[(newest + Length - min(older + 1, stored - 1)) % Length];
+        if (bird >= a.x.size())
+        {
+            return false;
+        }
+        if (bird >= b.x.size() || fabs(a.x[bird] - b.x[bird]) > 64.0f || fabs(a.y[bird] - b.y[bird]) > 64.0f)
+        {
+            // No older entry, or the bird was respawned in between, so there is nothing to blend with
+            blend = 0.0f;
+        }
+        const Snapshot& nearest = blend < 0.5f ? a : b;
+        x = a.x[bird] + (b.x[bird] - a.x[bird]) * blend;
+        y = a.y[bird] + (b.y[bird] - a.y[bird]) * blend;
+        frame = nearest.frame[bird];
+        return true;
+    }
+};
+
+// The game rules on their own: birds, shots, spawning and scoring, with no window, textures or sound
+class GameSimulation
+{
+    BirdStore birds; // Every bird in flight
+    SpatialHash birdGrid; // Broadphase for shots, kept in step with the birds every tick
+    vector<size_t> candidates; // Birds returned by the last grid query
+    BirdHistory history; // Where the birds were over the last few ticks
+    float maxBirdSpeed; // Fastest any bird can move (pixels per second), bounds how far a rewound shot searches
+    float tickLength; // Length of the last tick, to turn a shot's age into ticks
+    int& score;
+    int& streak;
+    Vector2u fieldSize; // Size of the play area birds fly across
+
+    GameClock clock; // Simulated time, and every cooldown and animation step waiting on it
+
+    float collisionCooldown; // Cooldown duration in seconds
+    bool isCollisionEnabled;
+    float clickCooldown; // 1 second cooldown between clicks
+    bool clickReady; // Whether the click cooldown has run out
+
+    WaveScheduler waves; // Decides when new birds join the flock
+
+    // Counter for missed shots
+    int missedShots;
+
+    Uint32 stateHash; // Running hash of the score, streak and misses after every tick
+
+    Profiler* profiler; // Times the phases of each tick, none when running headless
+
+public:
+    enum
+    {
+        RecentHits = 8 // Hit positions kept for effects, more than one shot can make
+    };
+
+private:
+    Uint32 hitCount; // Birds hit this game
+    Uint32 shotCount; // Shots fired this game
+    int bestStreak; // Longest streak this game
+    Vector2f hitPositions[RecentHits]; // Centre of each recent hit bird, by hit number modulo RecentHits
+
+public:
+    GameSimulation(const vector<BirdType>& birdTypes, const vector<SpawnRule>& waveTable, int& score, int& streak)
+        : birds(birdTypes), score(score), streak(streak), clock(1.0f / 120.0f), waves(waveTable)
+    {
+        hitCount = 0;
+        shotCount = 0;
+        bestStreak = 0;
+        collisionCooldown = 1.2f;
+        clickCooldown = 0.75f;
+        fieldSize = Vector2u(900, 800);
+        clickReady = false;
+        isCollisionEnabled = false;
+        missedShots = 0;
+        stateHash = 2166136261u;
+        profiler = nullptr;
+        tickLength = 1.0f / 120.0f;
+        maxBirdSpeed = waves.getMaxSpeed(birdTypes);
+
+        // The pool holds every bird the wave table can send, so escalating waves never allocate mid-game
+        size_t poolSize = waves.getPoolSize();
+        birds.reserve(poolSize);
+        birdGrid.reserve(poolSize);
+        history.reserve(poolSize);
+        clock.reserve(poolSize + 2); // A cooldown timer per bird, the click and the mode switch
+        birds.setClock(&clock);
+    }
+
+    void setProfiler(Profiler* tickProfiler)
+    {
+        profiler = tickProfiler;
+    }
+
+    void reset(const Vector2u& size, Uint32 seed)
+    {
+        // A new game: the same seed and inputs always play out the same way
+        fieldSize = size;
+        score = 0;
+        streak = 0;
+        stateHash = 2166136261u;
+        hitCount = 0;
+        shotCount = 0;
+        bestStreak = 0;
+        birds.random.setSeed(seed);
+        isCollisionEnabled = false;
+        missedShots = 0;
+
+        // The gun starts cooling down and the wavy birds switch their movement every second
+        clock.reset();
+        clickReady = false;
+        clock.start(ClickReadyTimer, 0, clickCooldown);
+        clock.start(ModeSwitchTimer, 0, 1.0f, true);
+
+        // Waves that start straight away are in flight from the first frame
+        birds.clear();
+        waves.reset();
+        waves.update(clock.getTime(), streak, score, birds, fieldSize);
+        birdGrid.clear();
+        birdGrid.update(birds);
+        history.clear();
+        history.record(birds);
+    }
+
+    bool fire()
+    {
+        // Check if the cooldown has expired
+        if (clickReady)
+        {
+            isCollisionEnabled = true; // Enable collision detection
+            clickReady = false;
+            clock.start(ClickReadyTimer, 0, clickCooldown); // Restart the cooldown
+            shotCount++;
+            return true;
+        }
+        return false;
+    }
+
+    void resolveShot(const Vector2i& aim, float ticksAgo = 0.0f)
+    {
+        // Check for collisions only when the pistol is shooting
+        if (isCollisionEnabled)
+        {
+            bool hit = false; // Flag to check if a bird was hit
+
+            // Birds are judged where they were when the shot was fired, which can be a few ticks back
+            ticksAgo = min(ticksAgo, history.getMaxTicksAgo());
+            if (ticksAgo > 0.0f)
+            {
+                // The grid holds current positions, so widen the search by how far a bird could have flown since
+                float margin = maxBirdSpeed * ticksAgo * tickLength;
+                birdGrid.queryArea(FloatRect(aim.x - margin, aim.y - margin, margin * 2, margin * 2), candidates);
+            }
+            else
+            {
+                birdGrid.queryPoint(aim.x, aim.y, candidates);
+            }
+
+            // Every bird under the crosshair that is not cooling down gets hit
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                size_t i = candidates[c];
+                float x, y;
+                int frame;
+                if (birds.ready[i] && history.lookup(i, ticksAgo, x, y, frame) && birds.hitTestAt(i, aim.x, aim.y, x, y, frame))
+                {
+                    FloatRect bounds = birds.getBounds(i, x, y);
+                    hitPositions[hitCount % RecentHits] = Vector2f(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2);
+                    hitCount++;
+                    score += birds.points[i]; // Increment score
+                    streak += 1; // Increment streak
+                    bestStreak = max(bestStreak, streak);
+                    birds.randomizeStart(i, fieldSize); // Respawn bird
+                    birds.startCooldown(i, collisionCooldown); // Reset cooldown
+                    hit = true; // A bird was hit
+                }
+            }
+            if (hit)
+            {
+                birdGrid.update(birds); // Respawned birds moved
+            }
+
+            // If no bird was hit, increment missed shots
+            if (!hit)
+            {
+                missedShots++; // Increment missed shots
+                streak = 0;
+                if (missedShots >= 5)
+                {
+                    score -= 10; // Deduct 10 points from score
+                }
+            }
+            // Set isCollisionEnabled to false immediately after checking for collisions
+            isCollisionEnabled = false;
+        }
+    }
+
+    void updateSpawns()
+    {
+        waves.update(clock.getTime(), streak, score, birds, fieldSize);
+        birdGrid.update(birds);
+    }
+
+    void updateBirds(float deltaTime)
+    {
+        // Update bird movements and animations
+        birds.update(deltaTime, fieldSize);
+        birds.animate();
+        birdGrid.update(birds);
+        history.record(birds);
+    }
+
+    void advanceTimers(float deltaTime)
+    {
+        // The one place simulated time moves on, whatever expires takes effect before this tick's shot is judged
+        const vector<TimerEvent>& expired = clock.advance(deltaTime);
+        for (size_t i = 0; i < expired.size(); i++)
+        {
+            const TimerEvent& event = expired[i];
+            if (birds.handleTimer(event))
+            {
+                continue;
+            }
+            if (event.kind == ClickReadyTimer)
+            {
+                clickReady = true;
+            }
+            else if (event.kind == ModeSwitchTimer)
+            {
+                birds.toggleMovementMode(); // Toggle the wavy birds' movement mode
+            }
+        }
+    }
+
+    void tick(float deltaTime, const Vector2i& aim, float shotAge = 0.0f)
+    {
+        // One fixed simulation step, in the same order the game loop always used
+        tickLength = deltaTime;
+        advanceTimers(deltaTime);
+        {
+            ScopedTimer timer(profiler, "sim collision");
+            resolveShot(aim, shotAge / deltaTime);
+        }
+        hashState();
+        if (isGameOver())
+        {
+            return;
+        }
+        {
+            ScopedTimer timer(profiler, "sim spawns");
+            updateSpawns();
+        }
+        ScopedTimer timer(profiler, "sim birds");
+        updateBirds(deltaTime);
+    }
+
+    bool step(float deltaTime, const TickInput& input)
+    {
+        // A tick driven by recorded or live input, returns whether a shot was fired
+        bool fired = input.click && fire();
+        if (fired)
+        {
+            // Aim where and when the button went down, not where the cursor is now
+            tick(deltaTime, input.clickPosition, input.clickAge);
+        }
+        else
+        {
+            tick(deltaTime, input.mouse);
+        }
+        return fired;
+    }
+
+    void hashState()
+    {
+        // FNV-1a over the values a replay has to reproduce
+        const int values[3] = { score, streak, missedShots };
+        const unsigned char* bytes = (const unsigned char*)values;
+        for (size_t i = 0; i < sizeof(values); i++)
+        {
+            stateHash = (stateHash ^ bytes[i]) * 16777619u;
+        }
+    }
+
+    Uint32 getHitCount() const
+    {
+        return hitCount;
+    }
+
+    Uint32 getShotCount() const
+    {
+        return shotCount;
+    }
+
+    int getBestStreak() const
+    {
+        return bestStreak;
+    }
+
+    double getGameTime() const
+    {
+        return clock.getTime();
+    }
+
+    Vector2f getHitPosition(Uint32 hit) const
+    {
+        // Only the last RecentHits hits are kept
+        return hitPositions[hit % RecentHits];
+    }
+
+    Uint32 getStateHash() const
+    {
+        return stateHash;
+    }
+
+    bool isGameOver() const
+    {
+        return missedShots >= 10;
+    }
+
+    int getMissedShots() const
+    {
+        return missedShots;
+    }
+
+    int getScore() const
+    {
+        return score;
+    }
+
+    int getStreak() const
+    {
+        return streak;
+    }
+
+    const BirdStore& getBirds() const
+    {
+        return birds;
+    }
+
+    size_t getPoolSize() const
+    {
+        return waves.getPoolSize();
+    }
+};
+
+// Compact binary record of one game: the seed, every tick's input and the result the replay must match
+class InputLog
+{
+    enum Flags
+    {
+        ClickFlag = 1,
+        TabFlag = 2,
+        MovedFlag = 4 // The mouse position follows as two 16 bit values
+    };
+    // A click is followed by its position and its age as a 32 bit float
+
+    static void writePosition(ostream& out, const Vector2i& position)
+    {
+        Int16 values[2] = { (Int16)position.x, (Int16)position.y };
+        char bytes[4] = { (char)values[0], (char)(values[0] >> 8), (char)values[1], (char)(values[1] >> 8) };
+        out.write(bytes, 4);
+    }
+
+    static Vector2i readPosition(istream& in)
+    {
+        unsigned char bytes[4] = { 0, 0, 0, 0 };
+        in.read((char*)bytes, 4);
+        return Vector2i((Int16)(bytes[0] | (bytes[1] << 8)), (Int16)(bytes[2] | (bytes[3] << 8)));
+    }
+
+    static void writeValue(ostream& out, Uint32 value)
+    {
+        // Little endian, so logs are portable between machines
+        char bytes[4] = { (char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24) };
+        out.write(bytes, 4);
+    }
+
+    static Uint32 readValue(istream& in)
+    {
+        unsigned char bytes[4] = { 0, 0, 0, 0 };
+        in.read((char*)bytes, 4);
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+    }
+
+public:
+    Uint32 seed;
+    Vector2u fieldSize;
+    vector<TickInput> ticks;
+
+    // Result of the recorded game
+    int finalScore, finalStreak, finalMisses;
+    Uint32 stateHash;
+
+    InputLog()
+    {
+        begin(0, Vector2u(900, 800));
+    }
+
+    void begin(Uint32 gameSeed, const Vector2u& size)
+    {
+        seed = gameSeed;
+        fieldSize = size;
+        ticks.clear();
+        finalScore = finalStreak = finalMisses = 0;
+        stateHash = 0;
+    }
+
+    void finish(int score, int streak, int misses, Uint32 hash)
+    {
+        finalScore = score;
+        finalStreak = streak;
+        finalMisses = misses;
+        stateHash = hash;
+    }
+
+    bool save(const string& filePath) const
+    {
+        ofstream out(filePath, ios::binary);
+        if (!out.is_open())
+        {
+            return false;
+        }
+        out.write("OOPSLOG5", 8); // Version 5: birds follow closed-form flight paths
+        writeValue(out, seed);
+        writeValue(out, fieldSize.x);
+        writeValue(out, fieldSize.y);
+        writeValue(out, (Uint32)ticks.size());
+        writeValue(out, (Uint32)finalScore);
+        writeValue(out, (Uint32)finalStreak);
+        writeValue(out, (Uint32)finalMisses);
+        writeValue(out, stateHash);
+
+        // One flag byte per tick, the mouse position only when it moved
+        Vector2i lastMouse(0, 0);
+        for (size_t i = 0; i < ticks.size(); i++)
+        {
+            const TickInput& input = ticks[i];
+            bool moved = i == 0 || input.mouse != lastMouse;
+            char flags = (input.click ? ClickFlag : 0) | (input.tabToggle ? TabFlag : 0) | (moved ? MovedFlag : 0);
+            out.put(flags);
+            if (moved)
+            {
+                writePosition(out, input.mouse);
+                lastMouse = input.mouse;
+            }
+            if (input.click)
+            {
+                // The exact float bits, so a replay rewinds by exactly the same amount
+                Uint32 ageBits;
+                memcpy(&ageBits, &input.clickAge, 4);
+                writePosition(out, input.clickPosition);
+                writeValue(out, ageBits);
+            }
+        }
+        return out.good();
+    }
+
+    bool load(const string& filePath)
+    {
+        ifstream in(filePath, ios::binary);
+        char magic[8] = {};
+        if (!in.is_open() || !in.read(magic, 8) || string(magic, 8) != "OOPSLOG5")
+        {
+            return false;
+        }
+        seed = readValue(in);
+        fieldSize.x = readValue(in);
+        fieldSize.y = readValue(in);
+        Uint32 tickCount = readValue(in);
+        finalScore = (int)readValue(in);
+        finalStreak = (int)readValue(in);
+        finalMisses = (int)readValue(in);
+        stateHash = readValue(in);
+
+        ticks.resize(tickCount);
+        Vector2i lastMouse(0, 0);
+        for (Uint32 i = 0; i < tickCount; i++)
+        {
+            int flags = in.get();
+            if (flags & MovedFlag)
+            {
+                lastMouse = readPosition(in);
+            }
+            ticks[i].mouse = lastMouse;
+            ticks[i].click = (flags & ClickFlag) != 0;
+            ticks[i].tabToggle = (flags & TabFlag) != 0;
+            ticks[i].clickPosition = lastMouse;
+            ticks[i].clickAge = 0.0f;
+            if (ticks[i].click)
+            {
+                ticks[i].clickPosition = readPosition(in);
+                Uint32 ageBits = readValue(in);
+                memcpy(&ticks[i].clickAge, &ageBits, 4);
+            }
+        }
+        return !in.fail();
+    }
+};
+
+// Lock-free ring for exactly one producing and one consuming thread
+template <typename T>
+class SpscQueue
+{
+    vector<T> items;
+    atomic<size_t> head; // Next item to pop, written by the consumer only
+    atomic<size_t> tail; // Next free slot, written by the producer only
+
+public:
+    SpscQueue(size_t capacity) : items(capacity), head(0), tail(0)
+    {
+    }
+
+    bool push(const T& item)
+    {
+        // False when full, never blocks
+        size_t position = tail.load(memory_order_relaxed);
+        if (position - head.load(memory_order_acquire) >= items.size())
+        {
+            return false;
+        }
+        items[position % items.size()] = item;
+        tail.store(position + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        // False when empty
+        size_t position = head.load(memory_order_relaxed);
+        if (position == tail.load(memory_order_acquire))
+        {
+            return false;
+        }
+        item = items[position % items.size()];
+        head.store(position + 1, memory_order_release);
+        return true;
+    }
+};
+
+// Lets a worker thread sleep until another thread hands it work, or until a deadline.
+// notify() only touches the mutex when the worker is actually asleep, so pushing work while it is busy stays lock-free.
+class WakeSignal
+{
+    mutex lock;
+    condition_variable wakeUp;
+    atomic<bool> pending; // Set by notify(), cleared when the worker wakes up
+    atomic<bool> sleeping; // The worker is in wait() or about to be
+
+public:
+    WakeSignal() : pending(false), sleeping(false)
+    {
+    }
+
+    void notify()
+    {
+        // Either the worker sees pending before it sleeps, or this sees it sleeping and wakes it
+        pending.store(true);
+        if (sleeping.load())
+        {
+            {
+                lock_guard<mutex> guard(lock); // The worker is in the wait, or is past checking pending
+            }
+            wakeUp.notify_one();
+        }
+    }
+
+    void wait(long long deadline = 0)
+    {
+        // Returns once notified or at the given nanosecondsNow() time, 0 for no deadline
+        unique_lock<mutex> guard(lock);
+        sleeping.store(true);
+        auto notified = [this] { return pending.exchange(false); };
+        if (deadline == 0)
+        {
+            wakeUp.wait(guard, notified);
+        }
+        else
+        {
+            chrono::steady_clock::time_point until(chrono::duration_cast<chrono::steady_clock::duration>(chrono::nanoseconds(deadline)));
+            wakeUp.wait_until(guard, until, notified);
+        }
+        sleeping.store(false);
+    }
+};
+
+// Three copies of a value so one writing and one reading thread never wait for each other.
+// The writer fills the back copy and publishes it, the reader swaps in the newest published copy.
+template <typename T>
+class TripleBuffer
+{
+    enum
+    {
+        NewFlag = 4 // Set on the middle index when it holds a copy the reader has not taken yet
+    };
+
+    T buffers[3];
+    atomic<unsigned> middle; // Copy being handed over
+    unsigned back; // Writer's copy
+    unsigned front; // Reader's copy
+
+public:
+    TripleBuffer() : middle(1)
+    {
+        back = 0;
+        front = 2;
+    }
+
+    T& getBack()
+    {
+        // Holds an older copy, so the writer has to fill in every field
+        return buffers[back];
+    }
+
+    void publish()
+    {
+        back = middle.exchange(back | NewFlag, memory_order_acq_rel) & 3;
+    }
+
+    bool update()
+    {
+        // Take the newest published copy, false when nothing new has been published
+        if (!(middle.load(memory_order_acquire) & NewFlag))
+        {
+            return false;
+        }
+        front = middle.exchange(front, memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const T& getFront() const
+    {
+        return buffers[front];
+    }
+};
+
+// A fixed set of sf::Sound voices shared by every sound effect, driven by its own thread.
+// Callers only push a request onto a lock-free queue; starting, scheduling and stealing voices happen on the voice thread.
+class VoicePool
+{
+public:
+    enum
+    {
+        QueueCapacity = 64 // Requests waiting for the voice thread, more than a frame's worth
+    };
+
+private:
+    struct VoiceRequest
+    {
+        const SoundBuffer* buffer;
+        int priority; // Higher priorities may take a voice from lower ones when all are busy
+        float volume;
+        long long startAt; // nanosecondsNow() time to start playing
+    };
+
+    SpscQueue<VoiceRequest> queue; // Filled by the game thread, emptied by the voice thread
+    WakeSignal signal; // Wakes the voice thread for a new request or to stop
+
+    // Owned by the voice thread once it runs
+    vector<Sound> voices;
+    vector<int> voicePriorities;
+    vector<long long> voiceStarts;
+    vector<VoiceRequest> scheduled; // Taken off the queue, waiting for their start time
+
+    atomic<size_t> dropped; // Requests that found the queue full or every voice busy with something more important
+    atomic<bool> running;
+    thread worker;
+
+    size_t findVoice(int priority) const
+    {
+        // A free voice, otherwise the least important and then oldest one, or voices.size() when none may be taken
+        size_t best = voices.size();
+        for (size_t i = 0; i < voices.size(); i++)
+        {
+            if (voices[i].getStatus() == SoundSource::Stopped)
+            {
+                return i;
+            }
+            if (voicePriorities[i] <= priority && (best == voices.size() || voicePriorities[i] < voicePriorities[best] ||
+                (voicePriorities[i] == voicePriorities[best] && voiceStarts[i] < voiceStarts[best])))
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void startVoice(const VoiceRequest& request)
+    {
+        size_t voice = findVoice(request.priority);
+        if (voice == voices.size())
+        {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        voices[voice].stop();
+        voices[voice].setBuffer(*request.buffer);
+        voices[voice].setVolume(request.volume);
+        voices[voice].play();
+        voicePriorities[voice] = request.priority;
+        voiceStarts[voice] = request.startAt;
+    }
+
+    void run()
+    {
+        while (running.load(memory_order_acquire))
+        {
+            // Take everything queued so far
+            VoiceRequest request;
+            while (queue.pop(request))
+            {
+                scheduled.push_back(request);
+            }
+
+            // Start whatever is due, in the order it was asked for
+            long long now = nanosecondsNow();
+            long long nextStart = 0;
+            size_t kept = 0;
+            for (size_t i = 0; i < scheduled.size(); i++)
+            {
+                if (scheduled[i].startAt <= now)
+                {
+                    startVoice(scheduled[i]);
+                }
+                else
+                {
+                    nextStart = kept == 0 ? scheduled[i].startAt : min(nextStart, scheduled[i].startAt);
+                    scheduled[kept++] = scheduled[i];
+                }
+            }
+            scheduled.resize(kept);
+
+            // Sleep until the next delayed sound is due, or with nothing scheduled until play() or stop() asks for more
+            signal.wait(nextStart);
+        }
+        for (size_t i = 0; i < voices.size(); i++)
+        {
+            voices[i].stop();
+        }
+    }
+
+public:
+    VoicePool(size_t polyphony = 16) : queue(QueueCapacity), voices(polyphony), voicePriorities(polyphony, 0), voiceStarts(polyphony, 0), dropped(0), running(false)
+    {
+    }
+
+    ~VoicePool()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        if (!running.exchange(true))
+        {
+            worker = thread(&VoicePool::run, this);
+        }
+    }
+
+    void stop()
+    {
+        running.store(false, memory_order_release);
+        signal.notify();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    bool play(const SoundBuffer& buffer, int priority, float volume = 100.0f, float delay = 0.0f)
+    {
+        // Called from the game thread only, never blocks; false when the queue is full
+        VoiceRequest request;
+        request.buffer = &buffer;
+        request.priority = priority;
+        request.volume = volume;
+        request.startAt = nanosecondsNow() + (long long)(delay * 1e9f);
+        if (!queue.push(request))
+        {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+        signal.notify();
+        return true;
+    }
+
+    size_t getDropped() const
+    {
+        return dropped.load(memory_order_relaxed);
+    }
+};
+
+bool syncFile(FILE* file)
+{
+    // Push the file's data past the OS cache onto the disk, so it survives a crash or power loss
+    if (fflush(file) != 0)
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+bool replaceFile(const string& from, const string& to)
+{
+    // Atomic: anyone opening the destination sees either the old file or the new one, never a mix
+#ifdef _WIN32
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    if (rename(from.c_str(), to.c_str()) != 0)
+    {
+        return false;
+    }
+
+    // The rename itself lives in the directory, which has to reach the disk too
+    size_t slash = to.find_last_of('/');
+    int directory = ::open(slash == string::npos ? "." : to.substr(0, slash + 1).c_str(), O_RDONLY);
+    if (directory >= 0)
+    {
+        fsync(directory);
+        ::close(directory);
+    }
+    return true;
+#endif
+}
+
+// One finished game, as the leaderboard keeps it
+struct RunRecord
+{
+    int score;
+    int bestStreak; // Longest streak during the game
+    Uint32 hits;
+    Uint32 shots;
+    int misses;
+    Uint32 playedMs; // Game time (milliseconds)
+    Uint64 playedAt; // When the game ended (seconds since 1970), 0 when not known
+};
+
+// Top scores with the stats of each run, kept in an append-only journal of checksummed records.
+// Little endian: "OOPSJRN1", then one record per game: score, best streak, hits, shots, misses, milliseconds played,
+// end time as two words, and an FNV-1a checksum of those 32 bytes.
+// Games are written by a thread of their own, so finishing one never waits on the disk. Each record is synced
+// before the next, so a crash loses at most the game being written; a torn record fails its checksum and is cut off.
+// Once the journal holds CompactAfter records it is rewritten with only the leaderboard, to a temporary file renamed
+// over the journal, so a crash mid-compaction leaves the old journal as it was.
+class Leaderboard
+{
+public:
+    enum
+    {
+        Capacity = 10, // Runs on the leaderboard
+        CompactAfter = 64, // Records the journal may hold before it is compacted
+        RecordSize = 36,
+        QueueCapacity = 16 // Finished games waiting for the writer
+    };
+
+private:
+    string filePath;
+    vector<RunRecord> board; // Best runs first, owned by the game thread
+    vector<RunRecord> unsent; // Runs that found the queue full, retried with the next one
+    int lastRank; // Place of the last submitted run, -1 when it missed the board
+
+    // Owned by the writer thread once it runs
+    vector<RunRecord> saved; // The leaderboard as it is on disk
+    size_t journalRecords; // Records in the journal file
+    bool compactPending; // The journal has a torn or unreadable tail that has to go before anything is appended
+
+    SpscQueue<RunRecord> queue; // Filled by the game thread, emptied by the writer
+    WakeSignal signal; // Wakes the writer for a new run or to stop
+    atomic<bool> running;
+    thread worker;
+
+    static bool ranksAbove(const RunRecord& a, const RunRecord& b)
+    {
+        // Higher scores first, the earlier of two equal scores keeps its place
+        return a.score > b.score;
+    }
+
+    static int addRun(vector<RunRecord>& runs, const RunRecord& run)
+    {
+        // Returns the run's place, -1 when it did not make the board
+        size_t place = upper_bound(runs.begin(), runs.end(), run, ranksAbove) - runs.begin();
+        if (place >= Capacity)
+        {
+            return -1;
+        }
+        runs.insert(runs.begin() + place, run);
+        if (runs.size() > Capacity)
+        {
+            runs.pop_back();
+        }
+        return (int)place;
+    }
+
+    static void encode(const RunRecord& run, Uint8* bytes)
+    {
+        const Uint32 values[8] = { (Uint32)run.score, (Uint32)run.bestStreak, run.hits, run.shots, (Uint32)run.misses, run.playedMs,
+            (Uint32)run.playedAt, (Uint32)(run.playedAt >> 32) };
+        for (int i = 0; i < 8; i++)
+        {
+            writeValue(bytes + i * 4, values[i]);
+        }
+        writeValue(bytes + 32, checksum(bytes, 32));
+    }
+
+    static bool decode(const Uint8* bytes, RunRecord& run)
+    {
+        if (readValue(bytes + 32) != checksum(bytes, 32))
+        {
+            return false;
+        }
+        run.score = (int)readValue(bytes);
+        run.bestStreak = (int)readValue(bytes + 4);
+        run.hits = readValue(bytes + 8);
+        run.shots = readValue(bytes + 12);
+        run.misses = (int)readValue(bytes + 16);
+        run.playedMs = readValue(bytes + 20);
+        run.playedAt = readValue(bytes + 24) | ((Uint64)readValue(bytes + 28) << 32);
+        return true;
+    }
+
+    static Uint32 checksum(const Uint8* bytes, size_t size)
+    {
+        Uint32 hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    static void writeValue(Uint8* bytes, Uint32 value)
+    {
+        bytes[0] = (Uint8)value;
+        bytes[1] = (Uint8)(value >> 8);
+        bytes[2] = (Uint8)(value >> 16);
+        bytes[3] = (Uint8)(value >> 24);
+    }
+
+    static Uint32 readValue(const Uint8* bytes)
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+    }
+
+    bool append(const RunRecord& run)
+    {
+        FILE* file = fopen(filePath.c_str(), "ab");
+        if (!file)
+        {
+            return false;
+        }
+        bool written = true;
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) == 0)
+        {
+            written = fwrite("OOPSJRN1", 1, 8, file) == 8; // A new journal
+        }
+        Uint8 bytes[RecordSize];
+        encode(run, bytes);
+        written = written && fwrite(bytes, 1, RecordSize, file) == RecordSize && syncFile(file);
+        fclose(file);
+        if (written)
+        {
+            journalRecords++;
+        }
+        return written;
+    }
+
+    bool compact()
+    {
+        // Write the leaderboard to a new file, only swapped in once it is entirely on disk
+        string tempPath = filePath + ".tmp";
+        FILE* file = fopen(tempPath.c_str(), "wb");
+        if (!file)
+        {
+            return false;
+        }
+        bool written = fwrite("OOPSJRN1", 1, 8, file) == 8;
+        for (size_t i = 0; i < saved.size(); i++)
+        {
+            Uint8 bytes[RecordSize];
+            encode(saved[i], bytes);
+            written = written && fwrite(bytes, 1, RecordSize, file) == RecordSize;
+        }
+        written = written && syncFile(file);
+        fclose(file);
+        if (!written || !replaceFile(tempPath, filePath))
+        {
+            remove(tempPath.c_str());
+            return false;
+        }
+        journalRecords = saved.size();
+        compactPending = false;
+        return true;
+    }
+
+    void save(const RunRecord& run)
+    {
+        addRun(saved, run);
+        if (compactPending)
+        {
+            // Appending after a torn record would hide the new one behind it, so the journal is rewritten instead
+            if (compact())
+            {
+                return;
+            }
+        }
+        if (!append(run))
+        {
+            cout << "Could not write " << filePath << endl;
+            compactPending = true; // Part of the record may have reached the file
+        }
+        else if (journalRecords >= CompactAfter)
+        {
+            compact();
+        }
+    }
+
+    void run()
+    {
+        if (compactPending)
+        {
+            compact();
+        }
+        for (;;)
+        {
+            // Checked before emptying the queue, so everything submitted before stop() is written
+            bool stopping = !running.load(memory_order_acquire);
+            RunRecord run;
+            while (queue.pop(run))
+            {
+                save(run);
+            }
+            if (stopping)
+            {
+                break;
+            }
+            signal.wait(); // Until submit() or stop()
+        }
+    }
+
+public:
+    Leaderboard() : queue(QueueCapacity), running(false)
+    {
+        lastRank = -1;
+        journalRecords = 0;
+        compactPending = false;
+    }
+
+    ~Leaderboard()
+    {
+        stop();
+    }
+
+    bool load(const string& journalPath)
+    {
+        // Reads every intact record, false when there is no journal yet. Call before start().
+        filePath = journalPath;
+        board.clear();
+        saved.clear();
+        journalRecords = 0;
+        compactPending = false;
+        ifstream in(filePath, ios::binary);
+        if (!in.is_open())
+        {
+            return false;
+        }
+        char magic[8] = {};
+        if (!in.read(magic, 8) || string(magic, 8) != "OOPSJRN1")
+        {
+            cout << filePath << " is not a score journal, starting a new one" << endl;
+            compactPending = true;
+            return false;
+        }
+        Uint8 bytes[RecordSize];
+        RunRecord run;
+        while (in.read((char*)bytes, RecordSize))
+        {
+            if (!decode(bytes, run))
+            {
+                break;
+            }
+            addRun(saved, run);
+            journalRecords++;
+        }
+        if (!in.eof() || in.gcount() != 0)
+        {
+            cout << filePath << ": dropped a damaged record after " << journalRecords << " good ones" << endl;
+            compactPending = true;
+        }
+        board = saved;
+        return true;
+    }
+
+    void start()
+    {
+        if (!running.exchange(true))
+        {
+            worker = thread(&Leaderboard::run, this);
+        }
+    }
+
+    void stop()
+    {
+        // Blocks until every submitted run is on disk
+        running.store(false, memory_order_release);
+        signal.notify();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        for (size_t i = 0; i < unsent.size(); i++)
+        {
+            save(unsent[i]);
+        }
+        unsent.clear();
+    }
+
+    int submit(const RunRecord& run)
+    {
+        // Called from the game thread only, never waits on the disk. Returns the run's place, -1 when it missed the board.
+        unsent.push_back(run);
+        size_t sent = 0;
+        while (sent < unsent.size() && queue.push(unsent[sent]))
+        {
+            sent++;
+        }
+        unsent.erase(unsent.begin(), unsent.begin() + sent);
+        if (sent > 0)
+        {
+            signal.notify();
+        }
+        lastRank = addRun(board, run);
+        return lastRank;
+    }
+
+    int getLastRank() const
+    {
+        return lastRank;
+    }
+
+    int getHighScore() const
+    {
+        // A best score below zero still shows as 0, as it always has
+        return board.empty() ? 0 : max(0, board[0].score);
+    }
+
+    const vector<RunRecord>& getRuns() const
+    {
+        return board;
+    }
+};
+
+const char* const ScoreJournalFile = "Scores.journal"; // Next to the game, replacing the Score.txt of older versions
+
+// What the renderer needs from the simulation, published after every batch of ticks
+struct FrameSnapshot
+{
+    vector<BirdSprite> birds;
+    int score, streak, misses;
+    Uint32 shots; // Shots fired this game, a change starts the shotgun animation
+    long long shotStamp; // When the click behind the latest shot was seen (nanoseconds)
+    Vector2i shotPosition; // Where the latest shot was aimed
+    Uint32 hits; // Birds hit this game, a change bursts feathers
+    Vector2f hitPositions[GameSimulation::RecentHits]; // Centre of each recent hit bird, by hit number modulo RecentHits
+    bool gameOver;
+    double simTime; // Simulation time after the last tick
+    long long tickedAt; // When the last tick ran (nanoseconds), to blend towards the next one
+
+    FrameSnapshot()
+    {
+        score = streak = misses = 0;
+        shots = 0;
+        shotStamp = 0;
+        hits = 0;
+        gameOver = false;
+        simTime = 0.0;
+        tickedAt = 0;
+    }
+};
+
+// Runs a GameSimulation at its fixed rate on a thread of its own, so a slow frame or display never holds up gameplay.
+// Input arrives through a lock-free queue and each result leaves as a snapshot through a triple buffer.
+class SimulationThread
+{
+public:
+    enum InputKind
+    {
+        MoveInput, // The mouse moved to position
+        ClickInput, // Left click at position
+        TabInput // Cursor confinement toggled
+    };
+
+    struct InputEvent
+    {
+        InputKind kind;
+        Vector2i position;
+        double time; // Simulation time on screen when a click happened
+        long long stamp; // When a click was seen (nanoseconds)
+    };
+
+    enum
+    {
+        InputCapacity = 256, // Events waiting for the next tick
+        MaxCatchUpTicks = 8 // Ticks run back to back after a stall before the simulation skips ahead
+    };
+
+private:
+    GameSimulation& simulation;
+    float tickLength;
+    SpscQueue<InputEvent> inputs;
+    TripleBuffer<FrameSnapshot> snapshots;
+    atomic<bool> running;
+    thread worker;
+
+    // Owned by the simulation thread while it runs
+    InputLog* log; // Every tick's input is recorded here when set
+    Vector2i mouse;
+    double simTime;
+    Uint32 shots;
+    long long shotStamp;
+    Vector2i shotPosition;
+
+    void tick()
+    {
+        // Everything that arrived since the last tick is applied at its start, the latest click wins
+        TickInput input = { mouse, false, false, mouse, 0.0f };
+        double clickTime = 0.0;
+        long long clickStamp = 0;
+        InputEvent event;
+        while (inputs.pop(event))
+        {
+            if (event.kind == MoveInput)
+            {
+                mouse = event.position;
+            }
+            else if (event.kind == ClickInput)
+            {
+                input.click = true;
+                input.clickPosition = event.position;
+                clickTime = event.time;
+                clickStamp = event.stamp;
+            }
+            else if (event.kind == TabInput)
+            {
+                input.tabToggle = true;
+            }
+        }
+        input.mouse = mouse;
+        if (input.click)
+        {
+            input.clickAge = (float)max(0.0, simTime - clickTime);
+        }
+        else
+        {
+            input.clickPosition = mouse;
+        }
+        if (log)
+        {
+            log->ticks.push_back(input);
+        }
+
+        if (simulation.step(tickLength, input))
+        {
+            shots++;
+            shotStamp = clickStamp;
+            shotPosition = input.clickPosition;
+        }
+        simTime += tickLength;
+    }
+
+    void publish(long long tickedAt)
+    {
+        FrameSnapshot& snapshot = snapshots.getBack();
+        snapshot.birds.reserve(simulation.getPoolSize()); // Only the first publish into each slot allocates
+        simulation.getBirds().capture(snapshot.birds);
+        snapshot.score = simulation.getScore();
+        snapshot.streak = simulation.getStreak();
+        snapshot.misses = simulation.getMissedShots();
+        snapshot.shots = shots;
+        snapshot.shotStamp = shotStamp;
+        snapshot.shotPosition = shotPosition;
+        snapshot.hits = simulation.getHitCount();
+        for (Uint32 i = 0; i < GameSimulation::RecentHits; i++)
+        {
+            snapshot.hitPositions[i] = simulation.getHitPosition(i);
+        }
+        snapshot.gameOver = simulation.isGameOver();
+        snapshot.simTime = simTime;
+        snapshot.tickedAt = tickedAt;
+        snapshots.publish();
+    }
+
+    void run()
+    {
+        long long tickNanoseconds = (long long)(tickLength * 1e9);
+        long long nextTick = nanosecondsNow() + tickNanoseconds;
+        while (running.load(memory_order_acquire) && !simulation.isGameOver())
+        {
+            long long now = nanosecondsNow();
+            if (now < nextTick)
+            {
+                this_thread::sleep_for(chrono::nanoseconds(nextTick - now));
+                continue;
+            }
+
+            // Catch up on the ticks that are due, skipping ahead after a long stall instead of snowballing
+            for (int i = 0; i < MaxCatchUpTicks && nextTick <= now && !simulation.isGameOver(); i++)
+            {
+                tick();
+                nextTick += tickNanoseconds;
+            }
+            if (nextTick <= now)
+            {
+                nextTick = now + tickNanoseconds;
+            }
+            publish(nanosecondsNow());
+        }
+    }
+
+public:
+    SimulationThread(GameSimulation& simulation, float tickLength) : simulation(simulation), tickLength(tickLength), inputs(InputCapacity), running(false)
+    {
+        log = nullptr;
+        simTime = 0.0;
+        shots = 0;
+        shotStamp = 0;
+    }
+
+    ~SimulationThread()
+    {
+        stop();
+    }
+
+    void start(const Vector2i& mousePosition, InputLog* inputLog)
+    {
+        // The simulation has to be reset first, it is only touched by the thread until stop()
+        stop();
+        InputEvent event;
+        while (inputs.pop(event))
+        {
+        }
+        log = inputLog;
+        mouse = mousePosition;
+        simTime = 0.0;
+        shots = 0;
+        shotStamp = 0;
+        publish(nanosecondsNow());
+        running.store(true, memory_order_release);
+        worker = thread(&SimulationThread::run, this);
+    }
+
+    void stop()
+    {
+        running.store(false, memory_order_release);
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    bool pushInput(InputKind kind, const Vector2i& position, double time = 0.0, long long stamp = 0)
+    {
+        // Called from the render thread only, false when the simulation has fallen far behind
+        InputEvent event = { kind, position, time, stamp };
+        return inputs.push(event);
+    }
+
+    const FrameSnapshot& getSnapshot()
+    {
+        // Newest result, called from the render thread only
+        snapshots.update();
+        return snapshots.getFront();
+    }
+
+    float getTickLength() const
+    {
+        return tickLength;
+    }
+};
+
+class PistolSprite
+{
+    Sprite pistolSprite;
+    AnimationClip clip; // Shooting animation, placed on the atlas by load()
+    int currentFrame; // Current frame index
+    Uint32 shotStart; // Clock tick the shooting animation started on
+    Uint32 ticksPerFrame; // Length of a frame of the clip on the scene's clock
+    bool isShooting; // Flag to indicate if shooting animation is active
+
+    bool ready; // Whether the cooldown has run out
+    float shootCooldown; // Cooldown time (seconds)
+
+    shared_ptr<SoundBuffer> fireSoundBuffer; // Shared sound buffer for shotgun firing
+    shared_ptr<SoundBuffer> reloadSoundBuffer; // Shared sound buffer for shotgun reloading
+    VoicePool& voices; // Plays both, so a new shot never cuts off the last one
+    float reloadDelay; // Seconds from the shot to the reload sound
+
+    enum
+    {
+        FirePriority = 2, // A shot may take the voice of an older reload, never the other way round
+        ReloadPriority = 1
+    };
+
+    string filePath; // Sprite sheet, found in the asset manager once it has been loaded
+    bool loaded; // Whether the sheet and sounds have been attached
+
+
+public:
+    // Constructor, the sheet and sounds are attached later by load()
+    template <size_t Count>
+    PistolSprite(VoicePool& voices, const string& filePath, const ClipTable<Count>& shootingClip) : clip(shootingClip), voices(voices), filePath(filePath)
+    {
+        reloadDelay = 0.25f;
+        pistolSprite.setOrigin(400.f, 380.f);
+
+        pistolSprite.setScale(0.8f, 0.8f);  // Scale it down to fit the screen
+        currentFrame = 0;
+        shotStart = 0;
+        ticksPerFrame = 1;
+        isShooting = false;
+        ready = true;
+        shootCooldown = 0.74f; // Cooldown of 2 seconds between shots
+        loaded = false;
+    }
+
+    void reset()
+    {
+        // Called along with a reset of the scene's clock, which drops the pending timers
+        isShooting = false;
+        ready = true;
+        currentFrame = 0;
+    }
+
+    void load(AssetManager& assets)
+    {
+        // The sheet lives on whichever atlas page the loader put it on, only done once
+        if (loaded)
+        {
+            return;
+        }
+        loaded = true;
+
+        // Find the sprite sheet inside the shared atlas
+        clip.place(assets.getRegion(filePath));
+
+        // Set up the sprite
+        pistolSprite.setTexture(assets.getTexture(filePath));
+        pistolSprite.setTextureRect(clip.getFrame(0));  // Initial frame
+
+        // Sound effects are decoded once and shared through the asset manager
+        fireSoundBuffer = assets.getSound("Sound Effects/shotgun firing.ogg");
+        reloadSoundBuffer = assets.getSound("Sound Effects/shotgun reload.ogg");
+    }
+
+    void startShooting(GameClock& clock)
+    {
+        if (ready)
+        {
+            isShooting = true;
+            ready = false;
+            currentFrame = 0; // Reset animation to the first frame
+            shotStart = clock.getTicks();
+            ticksPerFrame = clock.ticksFor(clip.getFrameDuration());
+            clock.start(PistolReadyTimer, 0, shootCooldown);
+            voices.play(*fireSoundBuffer, FirePriority, 30);
+            voices.play(*reloadSoundBuffer, ReloadPriority, 30, reloadDelay);
+        }
+    }
+
+    bool handleTimer(const TimerEvent& event)
+    {
+        // False when the timer is not the pistol's
+        if (event.kind == PistolReadyTimer)
+        {
+            ready = true;
+            return true;
+        }
+        return false;
+    }
+
+    void updateAnimation(const GameClock& clock)
+    {
+        if (isShooting)
+        {
+            Uint32 elapsed = clock.getTicks() - shotStart;
+            if (clip.isFinished(elapsed, ticksPerFrame))
+            {
+                isShooting = false; // Stop animation after the last frame
+                currentFrame = 0;
+                return;
+            }
+
+            // The texture only changes when the frame does
+            int frame = clip.frameAt(elapsed, ticksPerFrame);
+            if (frame != currentFrame)
+            {
+                currentFrame = frame;
+                pistolSprite.setTextureRect(clip.getFrame(frame));
+            }
+        }
+    }
+
+
+    Sprite& getSprite()  // Provide access to the sprite
+    {
+        return pistolSprite;
+    }
+
+    void setPosition(float x, float y)
+    {
+        pistolSprite.setPosition(x, y);
+    }
+
+    Vector2f getMuzzlePosition() const
+    {
+        // End of the barrel, which points to the top left of each frame
+        return pistolSprite.getTransform().transformPoint(90.f, 115.f);
+    }
+
+    void rotateToMouse(float mouseX, float mouseY)
+    {
+        // Get the sprite's current position
+        float spriteX = pistolSprite.getPosition().x;
+        float spriteY = pistolSprite.getPosition().y;
+
+        // Calculate the difference in positions
+        float dx = mouseX - spriteX - 8000; // Adjust the offset if needed
+        float dy = mouseY - spriteY;
+
+        // Use a simple ratio to determine rotation
+        float angle = (dy / dx) * 90.0f; // Map to a rough [-45, 45] range
+
+        // Clamp the angle to keep it between -45 and +45
+        if (angle < -45.0f) angle = -45.0f;
+        if (angle > 45.0f) angle = 45.0f;
+
+        // Apply rotation to the sprite
+        pistolSprite.setRotation(angle);
+    }
+
+};
+
+// Static content drawn once into an offscreen texture and composited every frame until something changes
+class CachedLayer
+{
+    const LogicalScreen& screen; // The layer is drawn at its render scale
+    RenderTexture texture; // Only ever grows, a smaller scale draws into its top-left corner
+    Vector2u textureSize;
+    Sprite sprite; // Shows the texture at the layer's place on the logical screen
+    SpriteBatch batch; // Used only while redrawing the layer
+    FloatRect area; // Part of the logical screen the layer covers
+    float renderScale; // Render scale the texture was last drawn at, 0 before the first redraw
+    bool opaque; // An opaque layer replaces what is under it, a transparent one blends over it
+    bool dirty;
+
+public:
+    CachedLayer(const LogicalScreen& screen, bool opaque) : screen(screen), opaque(opaque)
+    {
+        textureSize = Vector2u(0, 0);
+        renderScale = 0.0f;
+        dirty = true;
+    }
+
+    void setArea(const FloatRect& newArea)
+    {
+        if (newArea != area)
+        {
+            area = newArea;
+            dirty = true;
+        }
+    }
+
+    void invalidate()
+    {
+        dirty = true;
+    }
+
+    bool isDirty() const
+    {
+        // A new render scale (the window was resized, went fullscreen or the quality changed) needs a redraw too
+        return dirty || renderScale != screen.getRenderScale();
+    }
+
+    SpriteBatch& beginRedraw()
+    {
+        // Pixel for pixel with the frame it is drawn into, so it is only resampled once, over the window
+        renderScale = screen.getRenderScale();
+        Vector2u size((unsigned int)ceil(max(area.width * renderScale, 1.0f)), (unsigned int)ceil(max(area.height * renderScale, 1.0f)));
+        if (size.x > textureSize.x || size.y > textureSize.y)
+        {
+            textureSize = Vector2u(max(size.x, textureSize.x), max(size.y, textureSize.y));
+            texture.create(textureSize.x, textureSize.y);
+            sprite.setTexture(texture.getTexture());
+        }
+        sprite.setTextureRect(IntRect(0, 0, size.x, size.y));
+        sprite.setPosition(area.left, area.top);
+        sprite.setScale(area.width / size.x, area.height / size.y);
+
+        // Draw in logical coordinates, the view maps the layer's area onto the part of the texture in use
+        View view(area);
+        view.setViewport(FloatRect(0, 0, (float)size.x / textureSize.x, (float)size.y / textureSize.y));
+        texture.clear(opaque ? Color::Black : Color::Transparent);
+        texture.setView(view);
+        batch.begin(texture);
+        return batch;
+    }
+
+    void endRedraw()
+    {
+        batch.end();
+        texture.display();
+        dirty = false;
+    }
+
+    void draw(SpriteBatch& target)
+    {
+        // The texture holds colors already multiplied by alpha, so blend it as premultiplied
+        target.draw(sprite, opaque ? BlendNone : BlendMode(BlendMode::One, BlendMode::OneMinusSrcAlpha));
+    }
+};
+
+// The crosshair's two bars, built once around the origin and only moved to the mouse each frame
+class Crosshair
+{
+    const Texture& atlas;
+    IntRect solidRegion; // Plain white area of the atlas
+    vector<Vertex> mesh;
+
+    void addRect(const FloatRect& rect)
+    {
+        float u = solidRegion.left + solidRegion.width / 2.0f;
+        float v = solidRegion.top + solidRegion.height / 2.0f;
+        Vector2f corners[4] =
+        {
+            Vector2f(rect.left, rect.top),
+            Vector2f(rect.left + rect.width, rect.top),
+            Vector2f(rect.left + rect.width, rect.top + rect.height),
+            Vector2f(rect.left, rect.top + rect.height)
+        };
+        const int order[6] = { 0, 1, 2, 0, 2, 3 };
+        for (int i = 0; i < 6; i++)
+        {
+            mesh.push_back(Vertex(corners[order[i]], Color::White, Vector2f(u, v)));
+        }
+    }
+
+public:
+    Crosshair(const Texture& atlas, const IntRect& solidRegion, const Vector2u& windowSize) : atlas(atlas), solidRegion(solidRegion)
+    {
+        // Horizontal line of the crosshair
+        Vector2f horizontalSize(windowSize.x / 15.f, 2.f); // 10% of the screen width, 2px height
+        addRect(FloatRect(-horizontalSize.x / 2.f, -horizontalSize.y / 2.f, horizontalSize.x, horizontalSize.y));
+
+        // Vertical line of the crosshair
+        Vector2f verticalSize(2.f, windowSize.y / 15.f); // 10% of the screen height, 2px width
+        addRect(FloatRect(-verticalSize.x / 2.f, -verticalSize.y / 2.f, verticalSize.x, verticalSize.y));
+    }
+
+    void draw(SpriteBatch& batch, const Vector2i& mousePos) const
+    {
+        batch.drawVertices(atlas, mesh, Vector2f((float)mousePos.x, (float)mousePos.y));
+    }
+};
+
+// How one kind of particle is launched and how it behaves afterwards
+struct ParticleStyle
+{
+    Color color;
+    float direction, spread; // Launch angle and how far either side of it a particle may go (degrees)
+    float minSpeed, maxSpeed; // Pixels per second
+    float minLife, maxLife; // Seconds
+    float minSize, maxSize; // Pixels
+    float growth; // Size change per second
+    float gravity; // Downward pull (pixels per second squared)
+    float drag; // Fraction of the speed lost per second
+};
+
+// Fixed-capacity pool of untextured square particles, stored as arrays so the update is one flat loop per field.
+// Live particles are packed at the front; a dead one is replaced by the last live one, so nothing is ever allocated after construction.
+class ParticleSystem
+{
+    const Texture& atlas;
+    Vector2f solidTexCoords; // Middle of the plain white area of the atlas
+    size_t capacity;
+    size_t count; // Live particles
+    vector<float> posX, posY;
+    vector<float> velX, velY;
+    vector<float> age, life;
+    vector<float> size, growth;
+    vector<float> gravity, drag;
+    vector<Color> color;
+    VertexArray vertices; // Every particle, two triangles each, drawn in one call
+    Random random;
+
+    void moveParticle(size_t from, size_t to)
+    {
+        posX[to] = posX[from];
+        posY[to] = posY[from];
+        velX[to] = velX[from];
+        velY[to] = velY[from];
+        age[to] = age[from];
+        life[to] = life[from];
+        size[to] = size[from];
+        growth[to] = growth[from];
+        gravity[to] = gravity[from];
+        drag[to] = drag[from];
+        color[to] = color[from];
+    }
+
+public:
+    ParticleSystem(const Texture& atlas, const IntRect& solidRegion, size_t capacity)
+        : atlas(atlas), capacity(capacity), posX(capacity), posY(capacity), velX(capacity), velY(capacity), age(capacity), life(capacity),
+        size(capacity), growth(capacity), gravity(capacity), drag(capacity), color(capacity), vertices(Triangles, capacity * 6)
+    {
+        solidTexCoords = Vector2f(solidRegion.left + solidRegion.width / 2.0f, solidRegion.top + solidRegion.height / 2.0f);
+        count = 0;
+    }
+
+    size_t emit(const ParticleStyle& style, const Vector2f& position, size_t amount)
+    {
+        // Returns how many fit, a full pool drops the rest rather than growing
+        amount = min(amount, capacity - count);
+        for (size_t n = 0; n < amount; n++)
+        {
+            size_t i = count++;
+            float angle = (style.direction + random.nextFloat(-style.spread, style.spread)) * 3.14159265f / 180.0f;
+            float speed = random.nextFloat(style.minSpeed, style.maxSpeed);
+            posX[i] = position.x;
+            posY[i] = position.y;
+            velX[i] = cos(angle) * speed;
+            velY[i] = sin(angle) * speed;
+            age[i] = 0.0f;
+            life[i] = random.nextFloat(style.minLife, style.maxLife);
+            size[i] = random.nextFloat(style.minSize, style.maxSize);
+            growth[i] = style.growth;
+            gravity[i] = style.gravity;
+            drag[i] = style.drag;
+            color[i] = style.color;
+        }
+        return amount;
+    }
+
+    void update(float deltaTime)
+    {
+        // No branches or calls in the loop, so the compiler can vectorize it
+        float* x = posX.data();
+        float* y = posY.data();
+        float* vx = velX.data();
+        float* vy = velY.data();
+        float* a = age.data();
+        float* s = size.data();
+        const float* g = growth.data();
+        const float* pull = gravity.data();
+        const float* d = drag.data();
+        for (size_t i = 0; i < count; i++)
+        {
+            float keep = 1.0f - d[i] * deltaTime;
+            vx[i] *= keep;
+            vy[i] = vy[i] * keep + pull[i] * deltaTime;
+            x[i] += vx[i] * deltaTime;
+            y[i] += vy[i] * deltaTime;
+            s[i] += g[i] * deltaTime;
+            a[i] += deltaTime;
+        }
+
+        // Remove the dead, filling each gap from the end
+        for (size_t i = 0; i < count;)
+        {
+            if (age[i] >= life[i] || size[i] <= 0.0f)
+            {
+                count--;
+                moveParticle(count, i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+
+    void buildVertices()
+    {
+        // Fade out over each particle's life
+        vertices.resize(count * 6);
+        for (size_t i = 0; i < count; i++)
+        {
+            float half = size[i] * 0.5f;
+            float left = posX[i] - half, right = posX[i] + half;
+            float top = posY[i] - half, bottom = posY[i] + half;
+            Color shade = color[i];
+            shade.a = (Uint8)(shade.a * (1.0f - age[i] / life[i]));
+
+            Vertex* quad = &vertices[i * 6];
+            quad[0] = Vertex(Vector2f(left, top), shade, solidTexCoords);
+            quad[1] = Vertex(Vector2f(right, top), shade, solidTexCoords);
+            quad[2] = Vertex(Vector2f(right, bottom), shade, solidTexCoords);
+            quad[3] = quad[0];
+            quad[4] = quad[2];
+            quad[5] = Vertex(Vector2f(left, bottom), shade, solidTexCoords);
+        }
+    }
+
+    void draw(SpriteBatch& batch)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        buildVertices();
+        batch.draw(vertices, RenderStates(&atlas));
+    }
 
+    void clear()
+    {
+        count = 0;
+    }
 
-        window.clear(Color::Black);
-        window.draw(backgroundSprite);
-        window.draw(shotgun.getSprite());
-        window.draw(white.getSprite());
-        window.draw(blue.getSprite());
-        if (turboBirdActive) // Draw Turbo Bird only if it's active
+    size_t getCount() const
+    {
+        return count;
+    }
+};
+
+void constrainCursor(LogicalScreen& screen)
+{
+    // Get the current position of the mouse on the logical screen
+    Vector2i mousePos = screen.getMouse();
+
+    // Get the size of the logical screen, the black bars around it count as outside
+    Vector2u windowSize = screen.getSize();
+
+    // Constrain the mouse position to stay within the window bounds (only on the top half)
+    if (mousePos.x < 0) mousePos.x = 0;
+    if (mousePos.x > (int)windowSize.x - 1) mousePos.x = windowSize.x - 1;
+
+    // Constrain the vertical position to be within the top half of the screen
+    if (mousePos.y < 0) mousePos.y = 0;
+    if (mousePos.y > (int)windowSize.y / 1.5) mousePos.y = windowSize.y / 1.5;
+
+    // Reset the mouse position if it was outside the window bounds
+    if (mousePos != screen.getMouse())
+    {
+        screen.setMouse(mousePos);
+    }
+}
+
+// Everything the scenes share, created once in main
+struct GameContext
+{
+    RenderWindow& window;
+    LogicalScreen& screen; // Scenes lay out and read the mouse in its coordinates, never the window's
+    AssetManager& assets;
+    Sprite& backgroundSprite;
+    Font& font1;
+    Font& font2;
+    const vector<BirdType>& birdTypes;
+    const vector<SpawnRule>& waves; // Which birds come when, from Waves.txt or the built in table
+    Leaderboard& leaderboard; // Best runs, saved on a thread of its own
+    int& score;
+    int& highScore;
+    int& streak;
+    string recordFile; // Where to save an input log of each game, empty to not record
+    Profiler& profiler;
+    AssetLoader& gameAssets; // Game scene assets, decoded in the background while the menu is up
+    VoicePool& voices; // Every sound effect plays through here
+};
+
+class Scene
+{
+public:
+    virtual ~Scene() {}
+
+    virtual void enter() {} // Called when the scene becomes the active one
+    virtual void exit() {} // Called when the scene is removed from the stack
+    virtual void handleEvent(const Event& event) = 0;
+    virtual void update(float deltaTime) = 0; // Advances the scene by one fixed simulation tick
+    virtual void draw(SpriteBatch& batch, float alpha) = 0; // alpha is how far the frame is between the last two ticks
+    virtual bool coversWindow() const { return false; } // True when draw() paints every pixel, so clearing can be skipped
+    virtual void presented(long long) {} // Called with the time (nanoseconds) a drawn frame was handed to the display
+};
+
+enum SceneId
+{
+    MenuSceneId,
+    GuideSceneId,
+    PlaySceneId,
+    GameOverSceneId,
+    SceneCount
+};
+
+class SceneManager
+{
+    enum Transition
+    {
+        NoTransition,
+        PushTransition,
+        PopTransition,
+        ReplaceTransition
+    };
+
+    RenderWindow& window;
+    LogicalScreen& screen; // Scenes draw into it, it is stretched over the window
+    Profiler& profiler; // Times each phase of the frame
+    ProfilerOverlay* overlay; // Frame statistics toggled with F3, none when not set
+    FramePacer* pacer; // Starts each frame on time, F5 changes its rate; none leaves it to SFML
+    Scene* scenes[SceneCount]; // Every scene is built once up front and reused
+    vector<Scene*> stack; // Active scenes, the top one receives input and draws
+    SpriteBatch batch; // Collects the frame's sprites into as few draw calls as possible
+    int drawCalls; // Draw calls used by the last frame
+
+    float tickLength; // Length of one simulation tick (seconds)
+    float maxFrameTime; // Longest frame the simulation tries to catch up on
+    Transition pendingTransition; // Requested change, applied between frames
+    SceneId pendingScene;
+
+    void applyTransition()
+    {
+        Transition transition = pendingTransition;
+        pendingTransition = NoTransition;
+
+        if (transition == PopTransition || transition == ReplaceTransition)
         {
-            window.draw(turbo.getSprite());
+            if (!stack.empty())
+            {
+                stack.back()->exit();
+                stack.pop_back();
+            }
         }
-        if (monsterActive) // Draw Turbo Bird only if it's active
+        if (transition == PushTransition || transition == ReplaceTransition)
         {
-            window.draw(monster.getSprite());
+            stack.push_back(scenes[pendingScene]);
+            stack.back()->enter();
         }
-        window.draw(scoreText);
-        window.draw(highScoreText);
-        window.draw(streakText);
-        window.draw(missText);
-
-        // Draw the crosshair
-        drawCrosshair(window);
-        window.display();
     }
-    // Update high score if needed
-    if (score > highScore)
+
+public:
+    SceneManager(RenderWindow& window, LogicalScreen& screen, const IntRect& solidRegion, Profiler& profiler)
+        : window(window), screen(screen), profiler(profiler)
     {
-        highScore = score;
-        ofstream writeFile(ScoreFile);
-        if (writeFile.is_open())
+        overlay = nullptr;
+        pacer = nullptr;
+        batch.setSolidRegion(solidRegion);
+        drawCalls = 0;
+        tickLength = 1.0f / 120.0f; // Simulate at 120 Hz whatever the frame rate is
+        maxFrameTime = 0.25f;
+        for (int i = 0; i < SceneCount; i++)
         {
-            writeFile << highScore;
-            writeFile.close();
+            scenes[i] = nullptr;
         }
+        stack.reserve(SceneCount); // The stack can never hold more scenes than exist, so it never reallocates
+        pendingTransition = NoTransition;
+        pendingScene = MenuSceneId;
+    }
+
+    void registerScene(SceneId id, Scene& scene)
+    {
+        scenes[id] = &scene;
     }
-    else
+
+    void setOverlay(ProfilerOverlay& profilerOverlay)
     {
-        cout << "High score remains: " << highScore << endl;
+        overlay = &profilerOverlay;
     }
-}
 
-// Forward declaration of functions
-void mainMenu(RenderWindow& window, Sprite& backgroundSprite, Font& font1, Font& font2, WhiteBird& white, BlueBird& blue, TurboBird& turbo, Bird& monster, string ScoreFile, int& score, int& highScore, int& streak);
-void showGuidelines(RenderWindow& window, Sprite& backgroundSprite, Font& font1, Font& font2, WhiteBird& white, BlueBird& blue, TurboBird& turbo, Bird& monster, string ScoreFile, int& score, int& highScore, int& streak);
+    void setPacer(FramePacer& framePacer)
+    {
+        pacer = &framePacer;
+        pacer->apply(window);
+    }
+
+    int getDrawCalls() const
+    {
+        return drawCalls;
+    }
+
+    void push(SceneId id)
+    {
+        pendingTransition = PushTransition;
+        pendingScene = id;
+    }
+
+    void pop()
+    {
+        pendingTransition = PopTransition;
+    }
+
+    void replace(SceneId id)
+    {
+        pendingTransition = ReplaceTransition;
+        pendingScene = id;
+    }
+
+    void run(SceneId firstScene)
+    {
+        push(firstScene);
+        applyTransition();
+
+        Clock deltaClock; // Clock for delta time
+        float accumulator = 0.0f; // Frame time not yet simulated
+        while (window.isOpen() && !stack.empty())
+        {
+            profiler.beginFrame();
+            if (pacer)
+            {
+                ScopedTimer timer(&profiler, "pacing");
+                pacer->beginFrame();
+            }
+            {
+                ScopedTimer timer(&profiler, "events");
+                Event event;
+                while (window.pollEvent(event))
+                {
+                    screen.translate(event);
+                    if (event.type == Event::Closed)
+                    {
+                        window.close();
+                    }
+                    else if (event.type == Event::Resized)
+                    {
+                        screen.resize();
+                    }
+                    else if (event.type == Event::KeyPressed && event.key.code == Keyboard::F11)
+                    {
+                        // A new window starts without the pacer's settings
+                        screen.toggleFullscreen();
+                        if (pacer)
+                        {
+                            pacer->apply(window);
+                        }
+                    }
+                    else if (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape)
+                    {
+                        window.close();
+                    }
+                    else if (event.type == Event::KeyPressed && event.key.code == Keyboard::F3 && overlay)
+                    {
+                        overlay->toggle();
+                    }
+                    else if (event.type == Event::KeyPressed && event.key.code == Keyboard::F5 && pacer)
+                    {
+                        pacer->cycle(window);
+                        cout << "Frame pacing: " << pacer->describe() << endl;
+                    }
+                    else if (event.type == Event::KeyPressed && event.key.code == Keyboard::F4)
+                    {
+                        // Save what the ring buffer holds for offline analysis
+                        if (profiler.exportChromeTrace("profile.json") && profiler.exportCsv("profile.csv"))
+                        {
+                            cout << "Saved profile.json and profile.csv" << endl;
+                        }
+                    }
+                    else
+                    {
+                        stack.back()->handleEvent(event);
+                    }
+                }
+            }
+
+            // Time elapsed since the last frame, capped so a long stall doesn't snowball into more catching up
+            float deltaTime = deltaClock.restart().asSeconds();
+            accumulator += min(deltaTime, maxFrameTime);
+
+            // Run as many fixed ticks as the frame time covers, so gameplay doesn't depend on the frame rate
+            while (accumulator >= tickLength && window.isOpen())
+            {
+                {
+                    ScopedTimer timer(&profiler, "tick");
+                    stack.back()->update(tickLength);
+                }
+                accumulator -= tickLength;
+
+                // Scene changes only take effect between ticks
+                if (pendingTransition != NoTransition)
+                {
+                    applyTransition();
+                    if (stack.empty())
+                    {
+                        break;
+                    }
+                }
+            }
+            if (!window.isOpen() || stack.empty())
+            {
+                break;
+            }
+            if (overlay)
+            {
+                overlay->update(deltaTime);
+            }
+
+            long long renderStart = nanosecondsNow();
+            {
+                ScopedTimer timer(&profiler, "draw");
+                batch.begin(screen.beginFrame(!stack.back()->coversWindow()));
+                stack.back()->draw(batch, accumulator / tickLength);
+                if (overlay && overlay->isVisible())
+                {
+                    overlay->draw(batch);
+                }
+            }
+            {
+                ScopedTimer timer(&profiler, "submit");
+                drawCalls = batch.end();
+            }
+            {
+                ScopedTimer timer(&profiler, "upscale");
+                screen.present();
+            }
+            long long renderTime = nanosecondsNow() - renderStart;
+            if (pacer)
+            {
+                ScopedTimer timer(&profiler, "pacing");
+                pacer->waitToPresent();
+            }
+            long long displayStart = nanosecondsNow();
+            {
+                ScopedTimer timer(&profiler, "display");
+                window.display();
+            }
+            long long presentTime = nanosecondsNow();
+
+            // Under vsync the display call blocks for the refresh, so the frame time says nothing about the load
+            if (!pacer || !pacer->isVSync())
+            {
+                renderTime += presentTime - displayStart;
+                screen.adapt(renderTime / 1e6f, pacer ? pacer->getFrameBudget() : 1000.0f / 60.0f, deltaTime);
+            }
+            stack.back()->presented(presentTime);
+            if (pacer)
+            {
+                pacer->presented(presentTime);
+            }
+            profiler.endFrame();
+        }
+
+        // Let every scene still on the stack clean up (e.g. save the high score)
+        while (!stack.empty())
+        {
+            stack.back()->exit();
+            stack.pop_back();
+        }
+    }
+};
 
-void showGuidelines(RenderWindow& window, Sprite& backgroundSprite, Font& font1, Font& font2, WhiteBird& white, BlueBird& blue, TurboBird& turbo, Bird& monster, string ScoreFile, int& score, int& highScore, int& streak)
+class GameScene : public Scene
 {
-    // Back Button
-    Texture backbuttontex;
-    Sprite backbuttonSprite;
-    backbuttontex.loadFromFile("Textures/back.png");
-    backbuttonSprite.setTexture(backbuttontex);
+    GameContext& context;
+    SceneManager& scenes;
+
+    // Game rules, birds and scoring, with no window attached, ticked on their own thread while the game runs
+    GameSimulation simulation;
+    SimulationThread simulationThread;
+
+    // Score, drawn from the baked font and only laid out again when a number changes
+    HudCounter scoreText;
+    HudCounter highScoreText;
+    HudCounter streakText;
+    HudCounter missText; // Text for misses
+
+    // In game Music
+    Music gameMusic;
+
+    // Pistol Sprite
+    PistolSprite shotgun;
+
+    // Flag to track if the cursor is confined
+    bool cursorConstrained;
+
+    GameClock clock; // Frame time on the render side, drives the pistol's animation and cooldown
+
+    // Clicks are matched with what was on screen when they happened
+    Vector2i lastMouse; // Last position sent to the simulation
+    double shownSimTime; // Simulation time of the last displayed frame, between two ticks
+    long long shownAt; // When that frame was displayed (nanoseconds)
+    double drawnSimTime; // Simulation time of the frame being drawn
+    Uint32 shotsSeen; // Shots in the last snapshot handled
+    long long shotStamp; // Click time of a fired shot waiting to reach the screen, 0 when none
+
+    // Record of this game's inputs, saved when recording is on
+    InputLog inputLog;
+
+    CachedLayer backgroundLayer; // The dimmed landscape, drawn once per game
+    Crosshair crosshair;
+
+    // Feathers from hit birds, smoke from the barrel and sparks where a shot lands
+    ParticleSystem particles;
+    ParticleStyle featherStyle, smokeStyle, sparkStyle;
+    Uint32 hitsSeen; // Hits in the last snapshot handled
+
+public:
+    GameScene(GameContext& context, SceneManager& scenes)
+        : context(context), scenes(scenes),
+        simulation(context.birdTypes, context.waves, context.score, context.streak),
+        simulationThread(simulation, 1.0f / 120.0f), // Same 120 Hz step as the scene manager
+        scoreText("Score: ", context.assets.getBitmapFont("Fonts/Super Childish.ttf", 24), context.assets.getAtlas()),
+        highScoreText("High Score: ", context.assets.getBitmapFont("Fonts/Super Childish.ttf", 24), context.assets.getAtlas()),
+        streakText("Streak: ", context.assets.getBitmapFont("Fonts/Super Childish.ttf", 24), context.assets.getAtlas()),
+        missText("Misses X ", context.assets.getBitmapFont("Fonts/Super Childish.ttf", 24), context.assets.getAtlas()),
+        shotgun(context.voices, "Textures/pump shotgun.png", ShotgunFrames),
+        backgroundLayer(context.screen, true),
+        crosshair(context.assets.getAtlas(), context.assets.getSolidRegion(), context.screen.getSize()),
+        particles(context.assets.getAtlas(), context.assets.getSolidRegion(), 4096)
+    {
+        backgroundLayer.setArea(FloatRect(0, 0, (float)context.screen.getSize().x, (float)context.screen.getSize().y));
 
-    // Set the origin to the center of the sprite (back button)
-    FloatRect bounds = backbuttonSprite.getGlobalBounds();
-    backbuttonSprite.setOrigin(bounds.width / 2, bounds.height / 2);
+        // Color, direction, spread, speed, life, size, growth, gravity, drag; angles in degrees clockwise from the right
+        featherStyle = { Color(250, 250, 245, 230), 270.f, 180.f, 40.f, 160.f, 0.6f, 1.2f, 3.f, 6.f, -2.f, 120.f, 2.5f };
+        smokeStyle = { Color(200, 200, 200, 120), 225.f, 20.f, 30.f, 80.f, 0.5f, 0.9f, 6.f, 10.f, 24.f, -30.f, 1.5f };
+        sparkStyle = { Color(255, 210, 90, 255), 0.f, 180.f, 150.f, 400.f, 0.15f, 0.35f, 2.f, 3.f, 0.f, 400.f, 3.f };
 
-    backbuttonSprite.setPosition(450.0f, 650.0f); // Position the sprite
-    Vector2f originalScale = backbuttonSprite.getScale();
-    Vector2f hoverScale = originalScale * 0.97f; // Slightly smaller scale for hover effect
+        simulation.setProfiler(&context.profiler);
+        missText.getText().setFillColor(Color::Red); // Set the color of the misses text to red
 
-    // Create a text object for the guidelines
-    Text guidelinesText;
-    guidelinesText.setFont(font1);
-    guidelinesText.setCharacterSize(25);
-    guidelinesText.setFillColor(Color::White);
-    guidelinesText.setPosition(50.f, 50.f);
+        // Positioning
+        scoreText.getText().setPosition(10, 10);
+        highScoreText.getText().setPosition(10, 40);
+        streakText.getText().setPosition(10, 70);
+        missText.getText().setPosition(10, 450);
 
-    // Set the guidelines text
-    string guidelines = "Game Guidelines:\n\n"
-        "The goal of the game is to shoot as many birds as possible while avoiding\n misses.\n\n"
-        "Each successful shot increases your score, and achieving a streak of 6 \nkills will introduce a new bird with unique movement patterns.\n\n"
-        "However, be carefulmissing shots can break your streak\n and allowing too many birds to escape will end the game!\n\n"
-        "Each bird has a different point value :\n"
-        "\n"
-        "White Bird : 1 point\n"
-        "Blue Bird : 2 points\n"
-        "Turbo Bird : 4 points\n"
-        "Monster : 7 points\n";
+        context.assets.openMusic(gameMusic, "Music/ingame music.ogg");
+        gameMusic.setLoop(true); // Set the music to loop
+        gameMusic.setVolume(100);
 
-    guidelinesText.setString(guidelines);
+        shotgun.setPosition(780.f, 790.f);  // Position of the pistol at the center of the screen
+    }
+
+    void enter()
+    {
+        LogicalScreen& screen = context.screen;
+        context.backgroundSprite.setColor(Color(255, 255, 255, 255 * 0.8));
+        backgroundLayer.invalidate();
+
+        // Normally loaded while the menu was up, this only waits if the game started without it
+        context.gameAssets.finish(context.assets);
+        shotgun.load(context.assets);
+        clock.reset();
+        shotgun.reset();
+
+        cursorConstrained = false;
+        shotStamp = 0;
+        shotsSeen = 0;
+        hitsSeen = 0;
+        particles.clear();
+        shownSimTime = 0.0;
+        drawnSimTime = 0.0;
+        shownAt = nanosecondsNow();
+
+        // Center the mouse cursor in the window
+        lastMouse = Vector2i(screen.getSize().x / 3, screen.getSize().y / 2);
+        screen.setMouse(lastMouse);
+
+        // Every game gets its own seed, kept in the log so a replay spawns the same birds
+        Uint32 seed = (Uint32)time(0);
+        simulation.reset(screen.getSize(), seed);
+        inputLog.begin(seed, screen.getSize());
+        simulationThread.start(lastMouse, context.recordFile.empty() ? nullptr : &inputLog);
+
+        gameMusic.play();
+    }
 
-    // Create a text object for the note about misses
-    Text noteText;
-    noteText.setFont(font1);
-    noteText.setCharacterSize(25);
-    noteText.setFillColor(Color::Red); // Set the color of the note text to red
-    noteText.setString("NOTE: 10 MISSES WILL END THE GAME!"); // Set the note text
-    noteText.setPosition(250.f, 570.f); // Position the note text below the guidelines
+    void exit()
+    {
+        // The score and the log belong to this thread again once the simulation has stopped
+        simulationThread.stop();
+        gameMusic.stop();
+        context.window.setMouseCursorVisible(true);
+
+        if (!context.recordFile.empty())
+        {
+            inputLog.finish(context.score, context.streak, simulation.getMissedShots(), simulation.getStateHash());
+            if (inputLog.save(context.recordFile))
+            {
+                cout << "Recorded " << inputLog.ticks.size() << " ticks to " << context.recordFile << endl;
+            }
+        }
 
+        // Every game goes to the leaderboard, which saves it in the background so the game over screen comes up straight away
+        RunRecord run;
+        run.score = context.score;
+        run.bestStreak = simulation.getBestStreak();
+        run.hits = simulation.getHitCount();
+        run.shots = simulation.getShotCount();
+        run.misses = simulation.getMissedShots();
+        run.playedMs = (Uint32)(simulation.getGameTime() * 1000.0);
+        run.playedAt = (Uint64)time(0);
+        if (context.leaderboard.submit(run) == 0 && context.score > context.highScore)
+        {
+            cout << "New high score: " << context.score << endl;
+        }
+        else
+        {
+            cout << "High score remains: " << context.highScore << endl;
+        }
+        context.highScore = context.leaderboard.getHighScore();
+    }
 
-    // Main loop for the guidelines window
-    while (window.isOpen())
+    void handleEvent(const Event& event)
     {
-        Event event;
-        while (window.pollEvent(event))
+        // Toggle the cursor confinement when the Tab key is pressed
+        if (event.type == Event::KeyPressed && event.key.code == Keyboard::Tab)
         {
-            if (event.type == Event::Closed)
+            simulationThread.pushInput(SimulationThread::TabInput, lastMouse);
+            cursorConstrained = !cursorConstrained;
+            if (cursorConstrained)
             {
-                window.close();
+                // Hide the cursor when it is confined
+                context.window.setMouseCursorVisible(false);
             }
-            if (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape)
+            else
             {
-                window.close();
+                // Show the cursor when it is free
+                context.window.setMouseCursorVisible(true);
             }
-            if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
+        }
+
+        // Handle mouse click (shooting)
+        if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
+        {
+            // Fired on the simulation's next tick, so a replay sees the click at exactly the same point.
+            // Where and when it happened are kept so the shot is judged against what was on screen.
+            // SFML gives no event timestamps, so the time it was polled is the closest we have,
+            // mapped onto the frame that was on screen then, running on from it, but never past the simulation.
+            long long stamp = nanosecondsNow();
+            double clickTime = min(simulationThread.getSnapshot().simTime, shownSimTime + (stamp - shownAt) / 1e9);
+            simulationThread.pushInput(SimulationThread::ClickInput, Vector2i(event.mouseButton.x, event.mouseButton.y), clickTime, stamp);
+        }
+    }
+
+    void update(float deltaTime)
+    {
+        // Update the shooting animation
+        {
+            ScopedTimer timer(&context.profiler, "animation");
+            const vector<TimerEvent>& expired = clock.advance(deltaTime);
+            for (size_t i = 0; i < expired.size(); i++)
             {
-                Vector2i mousePosition = Mouse::getPosition(window);
-                if (backbuttonSprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y))
-                {
-                    // Calling Main Menu
-                    mainMenu(window, backgroundSprite, font1, font2, white, blue, turbo, monster, ScoreFile, score, highScore, streak);
-                }
+                shotgun.handleTimer(expired[i]);
+            }
+            shotgun.updateAnimation(clock);
+        }
+
+        // If the cursor is confined, constrain its position within the window
+        if (cursorConstrained)
+        {
+            constrainCursor(context.screen);
+        }
+
+        // Get the current mouse position and hand it to the simulation when it changes
+        Vector2i mousePos = context.screen.getMouse();
+        if (mousePos != lastMouse)
+        {
+            simulationThread.pushInput(SimulationThread::MoveInput, mousePos);
+            lastMouse = mousePos;
+        }
+
+        // The simulation checks the cooldown, a new shot shows up in its snapshot
+        const FrameSnapshot& snapshot = simulationThread.getSnapshot();
+        if (snapshot.shots != shotsSeen)
+        {
+            shotsSeen = snapshot.shots;
+            shotgun.startShooting(clock);   // Start the shooting animation
+            shotStamp = snapshot.shotStamp; // Measured once the next frame is displayed
+            particles.emit(smokeStyle, shotgun.getMuzzlePosition(), 12);
+            particles.emit(sparkStyle, Vector2f(snapshot.shotPosition), 16);
+        }
+        for (Uint32 hit = max(hitsSeen, snapshot.hits - min(snapshot.hits, (Uint32)GameSimulation::RecentHits)); hit < snapshot.hits; hit++)
+        {
+            particles.emit(featherStyle, snapshot.hitPositions[hit % GameSimulation::RecentHits], 24);
+        }
+        hitsSeen = snapshot.hits;
+        {
+            ScopedTimer timer(&context.profiler, "particles");
+            particles.update(deltaTime);
+        }
+        if (snapshot.gameOver)
+        {
+            // Show the game over screen for a moment without blocking the loop
+            scenes.replace(GameOverSceneId);
+            return;
+        }
+
+        // Update texts
+        ScopedTimer timer(&context.profiler, "hud");
+        scoreText.setValue(snapshot.score);
+        highScoreText.setValue(context.highScore);
+        streakText.setValue(snapshot.streak);
+        missText.setValue(snapshot.misses);
+
+        // Get mouse position
+        shotgun.rotateToMouse(mousePos.x, mousePos.y);
+    }
+
+    void draw(SpriteBatch& batch, float)
+    {
+        if (backgroundLayer.isDirty())
+        {
+            backgroundLayer.beginRedraw().draw(context.backgroundSprite);
+            backgroundLayer.endRedraw();
+        }
+        backgroundLayer.draw(batch);
+        batch.draw(shotgun.getSprite());
+
+        // The newest snapshot, blended by how far the simulation thread should be towards its next tick
+        const FrameSnapshot& snapshot = simulationThread.getSnapshot();
+        float tickLength = simulationThread.getTickLength();
+        float alpha = min(1.0f, max(0.0f, (float)((nanosecondsNow() - snapshot.tickedAt) / 1e9) / tickLength));
+        drawBirdSprites(batch, snapshot.birds, alpha);
+        particles.draw(batch);
+        drawnSimTime = snapshot.simTime - tickLength + alpha * tickLength;
+
+        // Draw the crosshair
+        crosshair.draw(batch, context.screen.getMouse());
+
+        scoreText.draw(batch);
+        highScoreText.draw(batch);
+        streakText.draw(batch);
+        missText.draw(batch);
+    }
+
+    bool coversWindow() const
+    {
+        return true;
+    }
+
+    void presented(long long presentTime)
+    {
+        // Click to photon: from seeing the click to displaying the first frame with the shot in it
+        if (shotStamp != 0)
+        {
+            context.profiler.recordLatency((presentTime - shotStamp) / 1e6f);
+            shotStamp = 0;
+        }
+        shownSimTime = drawnSimTime;
+        shownAt = presentTime;
+    }
+};
+
+class GameOverScene : public Scene
+{
+    GameContext& context;
+
+    // Game Over Text
+    BitmapText gameOverText;
+    BitmapText finalScoreText;
+    BitmapText rankText; // The game's place on the leaderboard, if it made it
+
+    float displayTime; // How long the game over screen stays up (seconds)
+    float elapsedTime; // Time spent on the game over screen so far
+
+    CachedLayer screenLayer; // Nothing on this screen moves, so all of it is drawn once
+
+public:
+    GameOverScene(GameContext& context) : context(context),
+        gameOverText("Game Over", context.assets.getBitmapFont("Fonts/Super Childish.ttf", 50), context.assets.getAtlas()),
+        finalScoreText("Final Score: 0", context.assets.getBitmapFont("Fonts/Super Childish.ttf", 30), context.assets.getAtlas()),
+        rankText("", context.assets.getBitmapFont("Fonts/Super Childish.ttf", 24), context.assets.getAtlas()),
+        screenLayer(context.screen, true)
+    {
+        Vector2u size = context.screen.getSize();
+        screenLayer.setArea(FloatRect(0, 0, (float)size.x, (float)size.y));
+        gameOverText.setFillColor(Color::Red); // Set color to red
+        gameOverText.setPosition(size.x / 2 - 120, size.y / 2 - 50); // Center the text
+
+        finalScoreText.setFillColor(Color::White); // Set color to white
+        finalScoreText.setPosition(size.x / 2 - 100, size.y / 2 + 10); // Position below game over text
+
+        rankText.setFillColor(Color::Yellow);
+        rankText.setPosition(size.x / 2 - 100, size.y / 2 + 55); // Below the final score
+
+        displayTime = 3.0f;
+        elapsedTime = 0.0f;
+    }
+
+    void enter()
+    {
+        // Update final score text
+        finalScoreText.setString("Final Score: " + to_string(context.score));
+        int rank = context.leaderboard.getLastRank();
+        rankText.setString(rank == 0 ? "New high score!" : rank > 0 ? "Leaderboard #" + to_string(rank + 1) : "");
+        elapsedTime = 0.0f;
+        screenLayer.invalidate();
+    }
+
+    void handleEvent(const Event&)
+    {
+    }
+
+    void update(float deltaTime)
+    {
+        // Keep the window responsive while the game over screen is shown
+        elapsedTime += deltaTime;
+        if (elapsedTime >= displayTime)
+        {
+            context.window.close(); // Close the window or you can restart the game here
+        }
+    }
+
+    void draw(SpriteBatch& batch, float)
+    {
+        if (screenLayer.isDirty())
+        {
+            SpriteBatch& layerBatch = screenLayer.beginRedraw();
+            layerBatch.draw(context.backgroundSprite);
+            gameOverText.draw(layerBatch);
+            finalScoreText.draw(layerBatch);
+            rankText.draw(layerBatch);
+            screenLayer.endRedraw();
+        }
+        screenLayer.draw(batch);
+    }
+
+    bool coversWindow() const
+    {
+        return true;
+    }
+};
+
+class GuideScene : public Scene
+{
+    GameContext& context;
+    SceneManager& scenes;
+
+    // Back Button
+    Sprite backbuttonSprite;
+    Vector2f originalScale;
+    Vector2f hoverScale;
+
+    Text guidelinesText; // Text object for the guidelines
+    Text noteText; // Text object for the note about misses
+
+    CachedLayer pageLayer; // Background and text, only the back button is drawn every frame
+
+public:
+    GuideScene(GameContext& context, SceneManager& scenes) : context(context), scenes(scenes), pageLayer(context.screen, true)
+    {
+        pageLayer.setArea(FloatRect(0, 0, (float)context.screen.getSize().x, (float)context.screen.getSize().y));
+        context.assets.setAtlasSprite(backbuttonSprite, "Textures/back.png");
+
+        // Set the origin to the center of the sprite (back button)
+        FloatRect bounds = backbuttonSprite.getGlobalBounds();
+        backbuttonSprite.setOrigin(bounds.width / 2, bounds.height / 2);
+
+        backbuttonSprite.setPosition(450.0f, 650.0f); // Position the sprite
+        originalScale = backbuttonSprite.getScale();
+        hoverScale = originalScale * 0.97f; // Slightly smaller scale for hover effect
+
+        guidelinesText.setFont(context.font1);
+        guidelinesText.setCharacterSize(25);
+        guidelinesText.setFillColor(Color::White);
+        guidelinesText.setPosition(50.f, 50.f);
+
+        // Set the guidelines text
+        string guidelines = "Game Guidelines:\n\n"
+            "The goal of the game is to shoot as many birds as possible while avoiding\n misses.\n\n"
+            "Each successful shot increases your score, and achieving a streak of 6 \nkills will introduce a new bird with unique movement patterns.\n\n"
+            "However, be carefulmissing shots can break your streak\n and allowing too many birds to escape will end the game!\n\n"
+            "Each bird has a different point value :\n"
+            "\n"
+            "White Bird : 1 point\n"
+            "Blue Bird : 2 points\n"
+            "Turbo Bird : 4 points\n"
+            "Monster : 7 points\n";
+
+        guidelinesText.setString(guidelines);
+
+        noteText.setFont(context.font1);
+        noteText.setCharacterSize(25);
+        noteText.setFillColor(Color::Red); // Set the color of the note text to red
+        noteText.setString("NOTE: 10 MISSES WILL END THE GAME!"); // Set the note text
+        noteText.setPosition(250.f, 570.f); // Position the note text below the guidelines
+    }
+
+    void handleEvent(const Event& event)
+    {
+        if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
+        {
+            Vector2i mousePosition = context.screen.getMouse();
+            if (backbuttonSprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y))
+            {
+                // Back to the Main Menu underneath
+                scenes.pop();
             }
         }
+    }
 
+    void update(float)
+    {
         // Play Button Scale down when cursor on top
-        Vector2i mousePos = Mouse::getPosition(window);
+        Vector2i mousePos = context.screen.getMouse();
         if (backbuttonSprite.getGlobalBounds().contains((float)(mousePos.x), (float)(mousePos.y)))
         {
             backbuttonSprite.setScale(hoverScale);
         }
         else
         {
-            backbuttonSprite.setScale(originalScale);         // Set back to default size if the mouse is not over playbutton
+            backbuttonSprite.setScale(originalScale);         // Set back to default size if the mouse is not over playbutton
+        }
+    }
+
+    void enter()
+    {
+        pageLayer.invalidate(); // The background may have been dimmed differently since last time
+    }
+
+    void draw(SpriteBatch& batch, float)
+    {
+        if (pageLayer.isDirty())
+        {
+            SpriteBatch& layerBatch = pageLayer.beginRedraw();
+            layerBatch.draw(context.backgroundSprite); // Draw background if needed
+            layerBatch.draw(guidelinesText);
+            layerBatch.draw(noteText);
+            pageLayer.endRedraw();
         }
+        pageLayer.draw(batch);
+        batch.draw(backbuttonSprite);
+    }
 
-        window.clear(Color::Black);
-        window.draw(backgroundSprite); // Draw background if needed
-        window.draw(guidelinesText);
-        window.draw(noteText);
-        window.draw(backbuttonSprite);
-        window.display();
+    bool coversWindow() const
+    {
+        return true;
     }
-}
+};
 
-void mainMenu(RenderWindow& window, Sprite& backgroundSprite, Font& font1, Font& font2, WhiteBird& white, BlueBird& blue, TurboBird& turbo, Bird& monster, string ScoreFile, int& score, int& highScore, int& streak)
+class MenuScene : public Scene
 {
-    static Music bgMusic; // Declare bgMusic as static to maintain its state
-    static bool isMusicPlaying = false; // Track if music is currently playing
+    GameContext& context;
+    SceneManager& scenes;
 
-    // Title
-    Text GameName;
-    GameName.setFont(font1);
-    GameName.setCharacterSize(150);
-    GameName.setPosition(250.f, 110.f);
-    GameName.setFillColor(Color::White);
-    GameName.setString("OOPS!");
-
-    Text GameName1;
-    GameName1.setFont(font1);
-    GameName1.setCharacterSize(75);
-    GameName1.setPosition(320.f, 260.f);
-    GameName1.setFillColor(Color::White);
-    GameName1.setString("I MISSED");
+    Music bgMusic;
+    bool isSoundOn; // Track sound state
 
+    // Title
+    BitmapText GameName;
+    BitmapText GameName1;
     // Subtext
-    Text SubText;
-    SubText.setFont(font1);
-    SubText.setCharacterSize(30);
-    SubText.setPosition(350.f, 120.f);
-    SubText.setFillColor(Color::White);
-    SubText.setString("Limited Edition");
-
-    // Load and play music if not already playing
-    if (!isMusicPlaying) {
-        bgMusic.openFromFile("Music/main menu.ogg");
+    BitmapText SubText;
+
+    Sprite playbuttonsprite; // Play button
+    Sprite guidebuttonSprite; // Guide Button
+    Sprite soundonsprite;
+    Sprite soundoffsprite;
+    Vector2f originalScale, hoverScale;
+    Vector2f originalScale1, hoverScale1;
+    Vector2f originalScale2, hoverScale2;
+    Vector2f originalScale3, hoverScale3;
+
+    BirdStore birds; // Birds flying behind the menu
+    GameClock clock; // Steps the birds' animations and movement mode switches
+    bool playRequested; // Play was clicked before the game's assets were loaded
+
+    CachedLayer backgroundLayer; // The dimmed landscape
+    CachedLayer titleLayer; // Title and subtext, covering only their own area over the birds
+
+public:
+    MenuScene(GameContext& context, SceneManager& scenes)
+        : context(context), scenes(scenes),
+        birds(context.birdTypes),
+        backgroundLayer(context.screen, true),
+        titleLayer(context.screen, false)
+    {
+        AssetManager& assets = context.assets;
+        isSoundOn = true;
+        birds.setClock(&clock);
+
+        GameName.setFont(assets.getBitmapFont("Fonts/Super Childish.ttf", 150), assets.getAtlas());
+        GameName.setPosition(250.f, 110.f);
+        GameName.setFillColor(Color::White);
+        GameName.setString("OOPS!");
+
+        GameName1.setFont(assets.getBitmapFont("Fonts/Super Childish.ttf", 75), assets.getAtlas());
+        GameName1.setPosition(320.f, 260.f);
+        GameName1.setFillColor(Color::White);
+        GameName1.setString("I MISSED");
+
+        SubText.setFont(assets.getBitmapFont("Fonts/Super Childish.ttf", 30), assets.getAtlas());
+        SubText.setPosition(350.f, 120.f);
+        SubText.setFillColor(Color::White);
+        SubText.setString("Limited Edition");
+
+        backgroundLayer.setArea(FloatRect(0, 0, (float)context.screen.getSize().x, (float)context.screen.getSize().y));
+        FloatRect titleArea = GameName.getGlobalBounds();
+        FloatRect nameBounds = GameName1.getGlobalBounds();
+        FloatRect subBounds = SubText.getGlobalBounds();
+        float right = max(titleArea.left + titleArea.width, max(nameBounds.left + nameBounds.width, subBounds.left + subBounds.width));
+        float bottom = max(titleArea.top + titleArea.height, max(nameBounds.top + nameBounds.height, subBounds.top + subBounds.height));
+        titleArea.left = min(titleArea.left, min(nameBounds.left, subBounds.left));
+        titleArea.top = min(titleArea.top, min(nameBounds.top, subBounds.top));
+        titleLayer.setArea(FloatRect(floor(titleArea.left), floor(titleArea.top), ceil(right - titleArea.left) + 1, ceil(bottom - titleArea.top) + 1));
+
+        assets.openMusic(bgMusic, "Music/main menu.ogg");
         bgMusic.setLoop(true); // Set the music to loop
         bgMusic.setVolume(100);
-        bgMusic.play();
-        isMusicPlaying = true; // Update the music state
-    }
 
-    // Play button
-    Texture playbuttontex;
-    Sprite playbuttonsprite;
-    playbuttontex.loadFromFile("Textures/play1.png");
-    playbuttonsprite.setTexture(playbuttontex);
+        assets.setAtlasSprite(playbuttonsprite, "Textures/play1.png");
 
-    //Guide Button
-    Texture guidebuttontex;
-    Sprite guidebuttonSprite;
-    guidebuttontex.loadFromFile("Textures/guide.png");
-    guidebuttonSprite.setTexture(guidebuttontex);
-    guidebuttonSprite.setScale(0.2f, 0.2f);
+        assets.setAtlasSprite(guidebuttonSprite, "Textures/guide.png");
+        guidebuttonSprite.setScale(0.2f, 0.2f);
 
-    //soundon
-    Texture soundontex;
-    Sprite soundonsprite;
-    soundontex.loadFromFile("Textures/soundon.png");
-    soundonsprite.setTexture(soundontex);
-    soundonsprite.setScale(0.7f, 0.7f);
-    //soundoff
-    Texture soundofftex;
-    Sprite soundoffsprite;
-    soundofftex.loadFromFile("Textures/soundoff.png");
-    soundoffsprite.setTexture(soundofftex);
-    soundoffsprite.setScale(0.7f, 0.7f);
+        assets.setAtlasSprite(soundonsprite, "Textures/soundon.png");
+        soundonsprite.setScale(0.7f, 0.7f);
+        assets.setAtlasSprite(soundoffsprite, "Textures/soundoff.png");
+        soundoffsprite.setScale(0.7f, 0.7f);
 
-    // Set the origin to the center of the sprite (play button)
-    FloatRect bounds = playbuttonsprite.getGlobalBounds();
-    playbuttonsprite.setOrigin(bounds.width / 2, bounds.height / 2); // Set origin to center
+        // Set the origin to the center of the sprite (play button)
+        FloatRect bounds = playbuttonsprite.getGlobalBounds();
+        playbuttonsprite.setOrigin(bounds.width / 2, bounds.height / 2); // Set origin to center
 
-    playbuttonsprite.setPosition(450.0f, 500.0f); // Position the sprite
-    Vector2f originalScale = playbuttonsprite.getScale();
-    Vector2f hoverScale = originalScale * 0.97f; // Slightly smaller scale for hover effect
+        playbuttonsprite.setPosition(450.0f, 500.0f); // Position the sprite
+        originalScale = playbuttonsprite.getScale();
+        hoverScale = originalScale * 0.97f; // Slightly smaller scale for hover effect
 
-    // Set the origin to the center of the sprite (guide button)
-    FloatRect bounds1 = guidebuttonSprite.getGlobalBounds();
-    guidebuttonSprite.setOrigin(bounds1.width / 2, bounds1.height / 2); // Set origin to center
+        // Set the origin to the center of the sprite (guide button)
+        FloatRect bounds1 = guidebuttonSprite.getGlobalBounds();
+        guidebuttonSprite.setOrigin(bounds1.width / 2, bounds1.height / 2); // Set origin to center
 
-    guidebuttonSprite.setPosition(550.0f, 550.0f); // Position the sprite
-    Vector2f originalScale1 = guidebuttonSprite.getScale();
-    Vector2f hoverScale1 = originalScale1 * 0.97f; // Slightly smaller scale for hover effect
+        guidebuttonSprite.setPosition(550.0f, 550.0f); // Position the sprite
+        originalScale1 = guidebuttonSprite.getScale();
+        hoverScale1 = originalScale1 * 0.97f; // Slightly smaller scale for hover effect
 
-    // Set the origin to the center of the sprite (soundon button)
-    FloatRect bounds2 = soundonsprite.getGlobalBounds();
-    soundonsprite.setOrigin(bounds2.width / 2, bounds2.height / 2); // Set origin to center
+        // Set the origin to the center of the sprite (soundon button)
+        FloatRect bounds2 = soundonsprite.getGlobalBounds();
+        soundonsprite.setOrigin(bounds2.width / 2, bounds2.height / 2); // Set origin to center
 
-    soundonsprite.setPosition(300.0f, 575.0f); // Position the sprite
-    Vector2f originalScale2 = soundonsprite.getScale();
-    Vector2f hoverScale2 = originalScale2 * 0.97f; // Slightly smaller scale for hover effect
+        soundonsprite.setPosition(300.0f, 575.0f); // Position the sprite
+        originalScale2 = soundonsprite.getScale();
+        hoverScale2 = originalScale2 * 0.97f; // Slightly smaller scale for hover effect
 
-    // Set the origin to the center of the sprite (soundoff button)
-    FloatRect bounds3 = soundoffsprite.getGlobalBounds();
-    soundonsprite.setOrigin(bounds3.width / 2, bounds3.height / 2); // Set origin to center
+        // Set the origin to the center of the sprite (soundoff button)
+        FloatRect bounds3 = soundoffsprite.getGlobalBounds();
+        soundonsprite.setOrigin(bounds3.width / 2, bounds3.height / 2); // Set origin to center
 
-    soundoffsprite.setPosition(274.0f, 547.0f); // Position the sprite
-    Vector2f originalScale3 = soundoffsprite.getScale();
-    Vector2f hoverScale3 = originalScale3 * 0.97f; // Slightly smaller scale for hover effect
+        soundoffsprite.setPosition(274.0f, 547.0f); // Position the sprite
+        originalScale3 = soundoffsprite.getScale();
+        hoverScale3 = originalScale3 * 0.97f; // Slightly smaller scale for hover effect
+    }
 
-    // Initialize Birds
-    Movement whiteMovement(3.0f);
-    whiteMovement.randomizeStart(white.getSprite(), window.getSize());
+    void enter()
+    {
+        context.backgroundSprite.setColor(Color(255, 255, 255, 255 * 0.5));
+        backgroundLayer.invalidate();
 
-    Movement blueMovement(4.0f);
-    blueMovement.randomizeStart(blue.getSprite(), window.getSize());
+        // Play music
+        if (isSoundOn)
+        {
+            bgMusic.play();
+        }
 
-    SinMovement turboMovement(300.0f, 7.0f, 10.0f); // Speed = 100, Amplitude = 6.0, Frequency = 10.0
-    turboMovement.randomizeStart(turbo.getSprite(), window.getSize());
+        // Start decoding the game's assets while the player looks at the menu
+        context.gameAssets.start(min(2048u, Texture::getMaximumSize()));
+        playRequested = false;
+
+        // Initialize Birds
+        birds.random.setSeed((Uint32)time(0));
+        clock.reset();
+        birds.clear();
+        birds.spawn(WhiteBirdType, context.screen.getSize(), 0.0f);
+        birds.spawn(BlueBirdType, context.screen.getSize(), 0.0f);
+        birds.spawn(TurboBirdType, context.screen.getSize(), 0.0f);
+        clock.start(ModeSwitchTimer, 0, 1.0f, true); // Toggle turbo bird's movement mode every second
+    }
 
-    Clock deltaClock;    // Clock for delta time
-    Clock modeSwitch;    // Clock to toggle turbo movement mode
+    void exit()
+    {
+        bgMusic.stop();
+    }
 
-    window.setFramerateLimit(60);
-    bool isSoundOn = true; // Track sound state
-    while (window.isOpen())
+    void handleEvent(const Event& event)
     {
-        Event event;
-        while (window.pollEvent(event))
+        if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
         {
-            if (event.type == Event::Closed)
+            Vector2i mousePosition = context.screen.getMouse();
+            if (playbuttonsprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y))
             {
-                window.close();
+                // Start the game, or as soon as its assets are in
+                if (context.gameAssets.isReady())
+                {
+                    scenes.replace(PlaySceneId);
+                    return;
+                }
+                playRequested = true;
             }
-            if (event.type == Event::KeyPressed && event.key.code == Keyboard::Escape)
+
+            // Show the guidelines on top of the menu when the guide button is clicked
+            if (guidebuttonSprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y))
             {
-                window.close();
+                scenes.push(GuideSceneId);
             }
 
-            if (event.type == Event::MouseButtonPressed && event.mouseButton.button == Mouse::Left)
+            // Toggle sound on/off
+            if (soundonsprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y) && isSoundOn)
             {
-                Vector2i mousePosition = Mouse::getPosition(window);
-                if (playbuttonsprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y))
-                {
-                    bgMusic.stop();
-                    isMusicPlaying = false; // Reset music state
-                    GameWindow(window, backgroundSprite, font1, font2, white, blue, turbo, monster, ScoreFile, score, highScore, streak); // Open the new window
-                }
+                bgMusic.pause(); // Pause the music
+                isSoundOn = false; // Update sound state
+            }
+            else if (soundoffsprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y) && !isSoundOn)
+            {
+                bgMusic.play(); // Resume the music
+                isSoundOn = true; // Update sound state
+            }
+        }
+    }
 
-                // Call showGuidelines when the guide button is clicked
-                if (guidebuttonSprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y))
-                {
-                    showGuidelines(window, backgroundSprite, font1, font2, white, blue, turbo, monster, ScoreFile, score, highScore, streak); // Pass the main window and font to the guidelines function
-                }
+    void update(float deltaTime)
+    {
+        // Upload the game's assets once the loader has decoded them
+        if (context.gameAssets.update(context.assets) && playRequested)
+        {
+            scenes.replace(PlaySceneId);
+            return;
+        }
 
-                // Toggle sound on/off
-                if (soundonsprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y) && isSoundOn)
-                {
-                    bgMusic.pause(); // Pause the music
-                    isSoundOn = false; // Update sound state
-                }
-                else if (soundoffsprite.getGlobalBounds().contains(mousePosition.x, mousePosition.y) && !isSoundOn)
-                {
-                    bgMusic.play(); // Resume the music
-                    isSoundOn = true; // Update sound state
-                }
-            }
+        {
+            ScopedTimer timer(&context.profiler, "buttons");
 
             // Play Button Scale down when cursor on top
-            Vector2i mousePos = Mouse::getPosition(window);
+            Vector2i mousePos = context.screen.getMouse();
             if (playbuttonsprite.getGlobalBounds().contains((float)(mousePos.x), (float)(mousePos.y)))
             {
                 playbuttonsprite.setScale(hoverScale);
@@ -983,94 +6710,727 @@ void mainMenu(RenderWindow& window, Sprite& backgroundSprite, Font& font1, Font&
             }
         }
 
-        float deltaTime = deltaClock.restart().asSeconds(); // Time elapsed since the last frame
-
         // Update bird animations and movements
-        white.updateAnimation();
-        whiteMovement.update(white.getSprite(), window.getSize());
-        blue.updateAnimation();
-        blueMovement.update(blue.getSprite(), window.getSize());
-        turbo.updateAnimation();
-        turboMovement.update(turbo.getSprite(), window.getSize(), deltaTime);
-
-        // Toggle turbo bird's movement mode every 3 seconds
-        if (modeSwitch.getElapsedTime().asSeconds() > 1.0f)
+        ScopedTimer timer(&context.profiler, "birds");
+        const vector<TimerEvent>& expired = clock.advance(deltaTime);
+        for (size_t i = 0; i < expired.size(); i++)
         {
-            turboMovement.toggleMovementMode();
-            modeSwitch.restart();
+            if (!birds.handleTimer(expired[i]) && expired[i].kind == ModeSwitchTimer)
+            {
+                birds.toggleMovementMode();
+            }
         }
+        birds.update(deltaTime, context.screen.getSize());
+        birds.animate();
+    }
 
-        // Render the main menu
-        window.clear();
-        window.draw(backgroundSprite);
-        window.draw(GameName1);
-        window.draw(SubText);
-        window.draw(white.getSprite());
-        window.draw(blue.getSprite());
-        window.draw(turbo.getSprite());
-        window.draw(GameName);
-
+    void draw(SpriteBatch& batch, float alpha)
+    {
+        // Static parts come from their cached layers, only the birds and buttons are drawn from scratch
+        if (backgroundLayer.isDirty())
+        {
+            backgroundLayer.beginRedraw().draw(context.backgroundSprite);
+            backgroundLayer.endRedraw();
+        }
+        if (titleLayer.isDirty())
+        {
+            SpriteBatch& layerBatch = titleLayer.beginRedraw();
+            GameName1.draw(layerBatch);
+            SubText.draw(layerBatch);
+            GameName.draw(layerBatch);
+            titleLayer.endRedraw();
+        }
 
-        window.draw(playbuttonsprite);
-        window.draw(guidebuttonSprite);
+        backgroundLayer.draw(batch);
+        birds.draw(batch, alpha);
+        batch.draw(playbuttonsprite);
+        batch.draw(guidebuttonSprite);
         // Draw the appropriate sound button based on the sound state
         if (isSoundOn)
         {
-            window.draw(soundonsprite);
+            batch.draw(soundonsprite);
+        }
+        else
+        {
+            batch.draw(soundoffsprite);
+        }
+
+        // Loading bar above the play button until the game's assets are in
+        if (!context.gameAssets.isReady())
+        {
+            FloatRect bar(370.f, 425.f, 160.f, 6.f);
+            batch.drawRect(context.assets.getAtlas(), bar, Color(0, 0, 0, 120));
+            bar.width *= context.gameAssets.getProgress();
+            batch.drawRect(context.assets.getAtlas(), bar, Color::White);
+        }
+
+        titleLayer.draw(batch);
+    }
+
+    bool coversWindow() const
+    {
+        return true;
+    }
+};
+
+void addAtlasImages(AssetManager& assets)
+{
+    // Every sprite sheet and UI image needed from the start, the game scene adds its own in the background
+    assets.addToAtlas("Textures/landscape.jpg");
+    assets.addToAtlas("Textures/flappy bird white.png", true); // Birds also get hit masks
+    assets.addToAtlas("Textures/flappy bird blue.png", true);
+    assets.addToAtlas("Textures/turbo bird.png", true);
+    assets.addToAtlas("Textures/monster.png", true);
+    assets.addToAtlas("Textures/play1.png");
+    assets.addToAtlas("Textures/guide.png");
+    assets.addToAtlas("Textures/soundon.png");
+    assets.addToAtlas("Textures/soundoff.png");
+    assets.addToAtlas("Textures/back.png");
+}
+
+void addGameAssets(AssetLoader& loader)
+{
+    // Only the game scene needs these, so they are loaded in the background while the menu is up
+    loader.addImage("Textures/pump shotgun.png");
+    loader.addSound("Sound Effects/shotgun firing.ogg");
+    loader.addSound("Sound Effects/shotgun reload.ogg");
+}
+
+void addBitmapFonts(AssetManager& assets, bool rebake = false)
+{
+    // Every font size the game draws outside the guide, baked into the atlas
+    const unsigned int sizes[] = { 16, 24, 30, 50, 75, 150 };
+    for (unsigned int size : sizes)
+    {
+        assets.addBitmapFont("Fonts/Super Childish.ttf", size, rebake);
+    }
+}
+
+bool writeAssetPack(const string& filePath)
+{
+    // Decode everything once, ahead of time, so the game starts from the mapped pack instead of loose files
+    AssetManager assets;
+    addAtlasImages(assets);
+    addBitmapFonts(assets);
+    assets.packAtlas(4096);
+    AssetPackWriter writer;
+    assets.writePackedAtlas(writer);
+
+    bool complete = true;
+    AssetLoader gameAssets;
+    addGameAssets(gameAssets);
+    for (size_t i = 0; i < gameAssets.getImageFiles().size(); i++)
+    {
+        Image image;
+        if (image.loadFromFile(gameAssets.getImageFiles()[i]))
+        {
+            writer.addPixels(gameAssets.getImageFiles()[i], image);
         }
         else
         {
-            window.draw(soundoffsprite);
+            complete = false;
+        }
+    }
+    for (size_t i = 0; i < gameAssets.getSoundFiles().size(); i++)
+    {
+        complete = writer.addSound(gameAssets.getSoundFiles()[i]) && complete;
+    }
+
+    // Fonts and music are kept compressed, they are read from memory as they are used
+    const char* files[] = { "Fonts/Super Childish.ttf", "Fonts/Coffee Spark.ttf", "Music/main menu.ogg", "Music/ingame music.ogg" };
+    for (const char* file : files)
+    {
+        complete = writer.addFile(file) && complete;
+    }
+
+    if (!complete)
+    {
+        cout << "Some assets could not be read, the pack is incomplete" << endl;
+    }
+    return writer.save(filePath);
+}
+
+void runHeadless(long long ticks, Uint32 seed, const vector<SpawnRule>& waves)
+{
+    // Runs the game rules for a number of ticks with a scripted player and no window, then reports the cost
+    AssetManager assets;
+    addAtlasImages(assets);
+    assets.packAtlas(4096); // Only the frame sizes are needed, nothing is sent to a GPU
+    vector<BirdType> birdTypes;
+    makeBirdTypes(birdTypes, assets);
+
+    int score = 0;
+    int streak = 0;
+    Vector2u fieldSize(900, 800);
+    Random player(seed); // Drives the scripted player and hands out a seed to each game
+    GameSimulation simulation(birdTypes, waves, score, streak);
+    simulation.reset(fieldSize, player.next());
+    size_t poolCapacity = simulation.getBirds().posX.capacity();
+    size_t peakBirds = 0;
+    long long longestTick = 0;
+
+    // The simulation times its own phases, one profiler frame per tick, read back before the ring wraps
+    Profiler profiler;
+    simulation.setProfiler(&profiler);
+    vector<ProfileSample> samples;
+    Uint32 unreadFrom = 0; // First tick whose phases have not been added up yet
+    const long long readEvery = 4096; // Ticks between reads, three samples each is well inside the ring
+
+    const float tickLength = 1.0f / 120.0f; // Same step as the game loop
+    const int shotInterval = 96; // Ticks between attempted shots (0.8 seconds)
+    long long inputTime = 0, shotTime = 0, spawnTime = 0, birdTime = 0; // Nanoseconds spent in each phase
+    long long shotsFired = 0;
+    int gamesPlayed = 1;
+    int bestScore = 0;
+
+    long long startTime = nanosecondsNow();
+    for (long long t = 0; t < ticks; t++)
+    {
+        long long tickStart = nanosecondsNow();
+        profiler.beginFrame();
+
+        // Scripted player: aim at a random bird most of the time, anywhere otherwise, and fire regularly
+        const BirdStore& birds = simulation.getBirds();
+        Vector2i aim(player.nextInt(fieldSize.x), player.nextInt(fieldSize.y));
+        if (player.nextInt(4) != 0 && birds.count > 0)
+        {
+            FloatRect bounds = birds.getBounds(player.nextInt(birds.count));
+            aim = Vector2i((int)(bounds.left + bounds.width / 2), (int)(bounds.top + bounds.height / 2));
+        }
+        TickInput input = { aim, t % shotInterval == 0, false, aim, 0.0f };
+        long long stepStart = nanosecondsNow();
+        inputTime += stepStart - tickStart;
+
+        // The same step the live game and replays run
+        if (simulation.step(tickLength, input))
+        {
+            shotsFired++;
+        }
+        long long tickEnd = nanosecondsNow();
+        profiler.endFrame();
+        longestTick = max(longestTick, tickEnd - tickStart);
+        peakBirds = max(peakBirds, simulation.getBirds().count);
+
+        if (simulation.isGameOver())
+        {
+            // Start another game straight away
+            bestScore = max(bestScore, score);
+            simulation.reset(fieldSize, player.next());
+            gamesPlayed++;
+        }
+
+        if ((t + 1) % readEvery == 0 || t + 1 == ticks)
+        {
+            profiler.getRecentSamples(samples, unreadFrom);
+            unreadFrom = profiler.getFrame();
+            for (size_t i = 0; i < samples.size(); i++)
+            {
+                if (strcmp(samples[i].name, "sim collision") == 0)
+                {
+                    shotTime += samples[i].duration;
+                }
+                else if (strcmp(samples[i].name, "sim spawns") == 0)
+                {
+                    spawnTime += samples[i].duration;
+                }
+                else if (strcmp(samples[i].name, "sim birds") == 0)
+                {
+                    birdTime += samples[i].duration;
+                }
+            }
+        }
+    }
+    double seconds = (nanosecondsNow() - startTime) / 1e9;
+    bestScore = max(bestScore, score);
+
+    cout << "Simulated " << ticks << " ticks (" << ticks * tickLength << " s of game time) in " << seconds << " s, seed " << seed << endl;
+    cout << "Ticks per second: " << ticks / max(seconds, 1e-9) << endl;
+    cout << "Per tick cost (ns):" << endl;
+    cout << "  input\t" << (double)inputTime / max(ticks, 1LL) << endl;
+    cout << "  shots\t" << (double)shotTime / max(ticks, 1LL) << endl;
+    cout << "  spawns\t" << (double)spawnTime / max(ticks, 1LL) << endl;
+    cout << "  birds\t" << (double)birdTime / max(ticks, 1LL) << endl;
+    cout << "Longest tick: " << longestTick / 1000.0 << " us, " << longestTick / (tickLength * 1e7) << "% of the tick budget" << endl;
+    cout << "Bird pool: " << simulation.getPoolSize() << ", peak in flight: " << peakBirds
+         << (simulation.getBirds().posX.capacity() == poolCapacity ? ", never grew" : ", GREW mid-game") << endl;
+    cout << "Games played: " << gamesPlayed << ", shots fired: " << shotsFired << ", best score: " << bestScore << endl;
+}
+
+bool replayInputLog(const string& filePath)
+{
+    // Plays a recorded game back as fast as possible and checks it ends exactly as it did live
+    InputLog log;
+    if (!log.load(filePath))
+    {
+        cout << "Could not read input log " << filePath << endl;
+        return false;
+    }
+
+    AssetManager assets;
+    addAtlasImages(assets);
+    assets.packAtlas(4096); // Hit masks and frame sizes must match the live game
+    vector<BirdType> birdTypes;
+    makeBirdTypes(birdTypes, assets);
+
+    vector<SpawnRule> waves;
+    loadWaveTable(waves); // The recording only matches when played with the same table
+
+    int score = 0;
+    int streak = 0;
+    GameSimulation simulation(birdTypes, waves, score, streak);
+    simulation.reset(log.fieldSize, log.seed);
+
+    const float tickLength = 1.0f / 120.0f; // Same step as the game loop
+    size_t ticksPlayed = 0;
+    long long startTime = nanosecondsNow();
+    while (ticksPlayed < log.ticks.size() && !simulation.isGameOver())
+    {
+        simulation.step(tickLength, log.ticks[ticksPlayed]);
+        ticksPlayed++;
+    }
+    double seconds = (nanosecondsNow() - startTime) / 1e9;
+    double gameSeconds = ticksPlayed * tickLength;
+
+    cout << "Replayed " << ticksPlayed << " ticks (" << gameSeconds << " s of game time) in " << seconds << " s, "
+         << gameSeconds / max(seconds, 1e-9) << "x real time" << endl;
+    cout << "Score " << score << " (recorded " << log.finalScore << "), streak " << streak << " (recorded " << log.finalStreak
+         << "), misses " << simulation.getMissedShots() << " (recorded " << log.finalMisses << ")" << endl;
+
+    bool matches = ticksPlayed == log.ticks.size() && simulation.getStateHash() == log.stateHash;
+    cout << (matches ? "Replay matches the recording" : "Replay DIVERGED from the recording") << endl;
+    return matches;
+}
+
+void benchmarkBirdStore()
+{
+    // Measures BirdStore::update for growing flocks, the cost per bird should stay flat
+    AssetManager assets;
+    vector<BirdType> birdTypes;
+    makeBirdTypes(birdTypes, assets);
+    Vector2u windowSize(900, 800);
+    const int updates = 1200; // Ten seconds of 120 Hz simulation ticks
+
+    cout << "birds\tns per update\tns per bird" << endl;
+    for (size_t birdCount = 4; birdCount <= 262144; birdCount *= 4)
+    {
+        BirdStore birds(birdTypes);
+        birds.reserve(birdCount);
+        for (size_t i = 0; i < birdCount; i++)
+        {
+            birds.spawn(i % BirdTypeCount, windowSize, 0.0f);
+        }
+
+        Clock clock;
+        for (int i = 0; i < updates; i++)
+        {
+            birds.update(1.0f / 120.0f, windowSize);
+        }
+        double nsPerUpdate = clock.getElapsedTime().asMicroseconds() * 1000.0 / updates;
+        cout << birdCount << "\t" << nsPerUpdate << "\t" << nsPerUpdate / birdCount << endl;
+    }
+}
+
+void benchmarkFlightPaths()
+{
+    // Birds per second through the built SIMD kernel and the scalar one, on a flock flying every path shape
+    const size_t birdCount = 65536;
+    const int passes = 200;
+    Random random(12345);
+    vector<int> kind(birdCount);
+    vector<float> startX(birdCount), startY(birdCount), velX(birdCount), flightTime(birdCount), pathTime(birdCount);
+    vector<float> phaseRate(birdCount), scale(birdCount);
+    vector<float> x(birdCount), y(birdCount), scalarX(birdCount), scalarY(birdCount);
+    for (size_t i = 0; i < birdCount; i++)
+    {
+        kind[i] = random.nextInt(PathKindCount);
+        startX[i] = random.nextFloat(-50.0f, 950.0f);
+        startY[i] = random.nextFloat(0.0f, 200.0f);
+        velX[i] = random.nextFloat(-300.0f, 300.0f);
+        flightTime[i] = random.nextFloat(0.0f, 4.0f);
+        pathTime[i] = flightTime[i] * random.nextFloat(0.0f, 1.0f);
+        phaseRate[i] = random.nextFloat(0.5f, 2.0f);
+        scale[i] = random.nextFloat(0.0f, 90.0f);
+    }
+    FlightPaths paths = { kind.data(), startX.data(), startY.data(), velX.data(), flightTime.data(), pathTime.data(), phaseRate.data(),
+        scale.data(), x.data(), y.data() };
+    FlightPaths scalarPaths = paths;
+    scalarPaths.x = scalarX.data();
+    scalarPaths.y = scalarY.data();
+
+    long long start = nanosecondsNow();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        evaluatePaths(paths, birdCount);
+    }
+    long long simdTime = nanosecondsNow() - start;
+    start = nanosecondsNow();
+    for (int pass = 0; pass < passes; pass++)
+    {
+        evaluatePathsScalar(scalarPaths, 0, birdCount);
+    }
+    long long scalarTime = nanosecondsNow() - start;
+
+    // The kernels have to agree to the bit or replays would depend on the machine
+    size_t mismatches = 0;
+    for (size_t i = 0; i < birdCount; i++)
+    {
+        if (memcmp(&x[i], &scalarX[i], sizeof(float)) != 0 || memcmp(&y[i], &scalarY[i], sizeof(float)) != 0)
+        {
+            mismatches++;
+        }
+    }
+    float cosError = 0.0f;
+    for (int i = 0; i < 100000; i++)
+    {
+        cosError = max(cosError, (float)fabs(cosTurns(i / 100000.0f) - cos(i / 100000.0 * 6.283185307179586)));
+    }
+
+    double birds = (double)birdCount * passes;
+    cout << "kernel	birds per second	ns per bird" << endl;
+    cout << getPathKernelName() << "	" << birds / (simdTime / 1e9) << "	" << simdTime / birds << endl;
+    cout << "scalar	" << birds / (scalarTime / 1e9) << "	" << scalarTime / birds << endl;
+    cout << "Speedup " << (double)scalarTime / simdTime << ", " << mismatches << " birds differ, fast cosine within " << cosError << endl;
+}
+
+void benchmarkFramePacing(float rate)
+{
+    // The old limiter (SFML's: sleep for what is left of the frame) against the pacer, with a few milliseconds of uneven work per frame
+    const int frames = 600;
+    long long period = (long long)(1e9 / rate);
+    Random random(12345);
+    cout << "limiter\tmean ms\tsd ms\tp99 ms\tworst ms\tlate frames\tinput age ms" << endl;
+    for (int limiter = 0; limiter < 2; limiter++)
+    {
+        FramePacer pacer(rate, limiter == 0 ? FramePacer::UnlimitedPacing : FramePacer::LimitedPacing); // Unlimited only records
+        Clock frameClock;
+        for (int frame = 0; frame <= frames; frame++)
+        {
+            pacer.beginFrame();
+            long long workEnd = nanosecondsNow() + random.nextInt((unsigned int)(period / 2));
+            while (nanosecondsNow() < workEnd)
+            {
+            }
+            if (limiter == 0)
+            {
+                sf::sleep(microseconds(period / 1000) - frameClock.getElapsedTime());
+                frameClock.restart();
+            }
+            pacer.waitToPresent();
+            pacer.presented(nanosecondsNow());
+        }
+
+        FramePacer::Stats stats = pacer.getStats();
+        cout << (limiter == 0 ? "sleep" : "hybrid") << "\t" << stats.mean << "\t" << stats.deviation << "\t" << stats.p99 << "\t" << stats.worst << "\t" << stats.late << "\t" << stats.inputAge << endl;
+    }
+}
+
+void benchmarkParticles()
+{
+    // Keeps 100k particles alive at 60 FPS and times the update and the vertex fill that drawing them costs on the CPU
+    const size_t liveParticles = 100000;
+    const int frames = 600; // Ten seconds
+    const float frameTime = 1.0f / 60.0f;
+    Texture atlas;
+    ParticleSystem particles(atlas, IntRect(0, 0, 1, 1), liveParticles);
+    ParticleStyle style = { Color(255, 210, 90, 255), 0.f, 180.f, 20.f, 200.f, 0.5f, 2.0f, 2.f, 4.f, 1.f, 100.f, 1.f };
+    Random random(12345);
+
+    long long updateTime = 0, renderTime = 0;
+    size_t totalLive = 0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        // Top the pool back up across the screen, like many bursts at once
+        while (particles.getCount() < liveParticles)
+        {
+            particles.emit(style, Vector2f(random.nextFloat(0.f, 900.f), random.nextFloat(0.f, 800.f)), 64);
+        }
+        totalLive += particles.getCount();
+
+        long long start = nanosecondsNow();
+        particles.update(frameTime);
+        long long updated = nanosecondsNow();
+        particles.buildVertices();
+        renderTime += nanosecondsNow() - updated;
+        updateTime += updated - start;
+    }
+
+    double updateMs = updateTime / 1e6 / frames;
+    double renderMs = renderTime / 1e6 / frames;
+    cout << "particles\tupdate ms\tvertices ms\tns per particle\t% of a 60 FPS frame" << endl;
+    cout << totalLive / frames << "\t" << updateMs << "\t" << renderMs << "\t" << (updateTime + renderTime) / (double)totalLive << "\t" << (updateMs + renderMs) / (frameTime * 1000.0) * 100.0 << endl;
+}
+
+void benchmarkBroadphase()
+{
+    // Compares a linear scan over every bird with the spatial hash, at a constant number of birds per screen
+    AssetManager assets;
+    addAtlasImages(assets);
+    assets.packAtlas(4096);
+    vector<BirdType> birdTypes;
+    makeBirdTypes(birdTypes, assets);
+    Random random(12345); // Fixed seed so every run measures the same layout
+    const int shots = 20000;
+    const int updates = 120;
+
+    cout << "birds\tlinear ns per shot\thash ns per shot\thash update ns per tick" << endl;
+    for (size_t birdCount = 16; birdCount <= 65536; birdCount *= 4)
+    {
+        // Grow the field with the flock so each area holds about as many birds as the real game
+        unsigned side = (unsigned)(450 * sqrt((double)birdCount));
+        Vector2u fieldSize(side, side);
+        BirdStore birds(birdTypes);
+        birds.reserve(birdCount);
+        for (size_t i = 0; i < birdCount; i++)
+        {
+            birds.spawn(i % BirdTypeCount, fieldSize, 0.0f);
+        }
+        for (size_t i = 0; i < birdCount; i++)
+        {
+            birds.startX[i] = birds.posX[i] = (float)random.nextInt(side); // Spread them across instead of all at the edges
+        }
+
+        vector<Vector2f> aims(shots);
+        for (int s = 0; s < shots; s++)
+        {
+            // Aim at a bird half the time, at empty sky otherwise
+            FloatRect bounds = birds.getBounds(random.nextInt(birdCount));
+            aims[s] = random.nextInt(2) ? Vector2f(bounds.left + bounds.width / 2, bounds.top + bounds.height / 2)
+                                 : Vector2f((float)random.nextInt(side), (float)random.nextInt(side));
         }
 
+        size_t linearHits = 0;
+        long long start = nanosecondsNow();
+        for (int s = 0; s < shots; s++)
+        {
+            for (size_t i = 0; i < birds.count; i++)
+            {
+                if (birds.getBounds(i).contains(aims[s]))
+                {
+                    linearHits++;
+                }
+            }
+        }
+        double linearNs = (double)(nanosecondsNow() - start) / shots;
+
+        SpatialHash grid;
+        grid.update(birds);
+        vector<size_t> candidates;
+        size_t hashHits = 0;
+        start = nanosecondsNow();
+        for (int s = 0; s < shots; s++)
+        {
+            grid.queryPoint(aims[s].x, aims[s].y, candidates);
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                if (birds.getBounds(candidates[c]).contains(aims[s]))
+                {
+                    hashHits++;
+                }
+            }
+        }
+        double hashNs = (double)(nanosecondsNow() - start) / shots;
 
+        long long updateTime = 0; // Only the grid update, not the bird movement
+        for (int u = 0; u < updates; u++)
+        {
+            birds.update(1.0f / 120.0f, fieldSize);
+            start = nanosecondsNow();
+            grid.update(birds);
+            updateTime += nanosecondsNow() - start;
+        }
+        double updateNs = (double)updateTime / updates;
 
-        window.display();
+        cout << birdCount << "\t" << linearNs << "\t" << hashNs << "\t" << updateNs;
+        if (linearHits != hashHits)
+        {
+            cout << "\tmismatch: " << linearHits << " vs " << hashHits << " hits";
+        }
+        cout << endl;
     }
 }
 
-int main()
+int main(int argc, char* argv[])
 {
-    const string ScoreFile = "Score.txt";
+    // Command line tools
+    if (argc > 1 && string(argv[1]) == "--bench-birds")
+    {
+        benchmarkBirdStore();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-paths")
+    {
+        benchmarkFlightPaths();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-pacing")
+    {
+        benchmarkFramePacing(argc > 2 ? (float)atof(argv[2]) : 144.0f);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-broadphase")
+    {
+        benchmarkBroadphase();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bench-particles")
+    {
+        benchmarkParticles();
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--headless")
+    {
+        vector<SpawnRule> waves;
+        loadWaveTable(waves);
+        runHeadless(argc > 2 ? atoll(argv[2]) : 120000, argc > 3 ? (Uint32)atoll(argv[3]) : (Uint32)time(0), waves);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--stress-waves")
+    {
+        // The headless game with thousands of birds flying at once, to find the peak cost of a tick
+        vector<SpawnRule> waves;
+        makeStressWaves(waves, argc > 2 ? atoi(argv[2]) : 4096);
+        runHeadless(argc > 3 ? atoll(argv[3]) : 12000, 1, waves);
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--scores")
+    {
+        // Print the leaderboard from the journal
+        Leaderboard leaderboard;
+        leaderboard.load(ScoreJournalFile);
+        const vector<RunRecord>& runs = leaderboard.getRuns();
+        cout << "place\tscore\tbest streak\thits\tshots\tmisses\tseconds" << endl;
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            cout << i + 1 << "\t" << runs[i].score << "\t" << runs[i].bestStreak << "\t" << runs[i].hits << "\t" << runs[i].shots << "\t"
+                << runs[i].misses << "\t" << runs[i].playedMs / 1000.0 << endl;
+        }
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--bake-fonts")
+    {
+        // Bake the glyph pages ahead of time instead of on the first run
+        AssetManager assets;
+        addBitmapFonts(assets, true);
+        return 0;
+    }
+    if (argc > 2 && string(argv[1]) == "--replay")
+    {
+        return replayInputLog(argv[2]) ? 0 : 1;
+    }
+    if (argc > 1 && string(argv[1]) == "--pack")
+    {
+        // Build the asset pack the game loads from when it is there
+        return writeAssetPack(argc > 2 ? argv[2] : "Assets.pack") ? 0 : 1;
+    }
+    string recordFile; // Save an input log of every game when set
+    if (argc > 2 && string(argv[1]) == "--record")
+    {
+        recordFile = argv[2];
+    }
+
     int score = 0;         // Current score
     int highScore = 0;     // High score
     int streak = 0;        // Current kill streak
 
-    ifstream readFile(ScoreFile);
-    if (readFile.is_open())
+    // Without a journal yet, the high score an older version kept in Score.txt becomes the first run on the leaderboard
+    Leaderboard leaderboard;
+    if (!leaderboard.load(ScoreJournalFile) && leaderboard.getRuns().empty())
+    {
+        ifstream readFile("Score.txt");
+        RunRecord imported = { 0, 0, 0, 0, 0, 0, 0 };
+        if (readFile >> imported.score && imported.score > 0)
+        {
+            leaderboard.submit(imported);
+        }
+    }
+    highScore = leaderboard.getHighScore();
+    leaderboard.start(); // Saves each game in the background from here on
+
+    // 60 frames a second unless --fps asks for another rate (0 for unlimited) or --vsync leaves it to the display
+    FramePacer pacer(60.0f);
+    for (int i = 1; i < argc; i++)
     {
-        readFile >> highScore;
-        readFile.close();
+        if (string(argv[i]) == "--fps" && i + 1 < argc)
+        {
+            pacer.setTarget((float)atof(argv[++i]), FramePacer::LimitedPacing);
+        }
+        else if (string(argv[i]) == "--vsync")
+        {
+            pacer.setTarget(60.0f, FramePacer::VSyncPacing);
+        }
     }
-    else
+
+    // Any window size works, scenes still lay out for 900x800; --render-scale 0.5 to 1 fixes the share of window pixels rendered
+    RenderWindow window(VideoMode(LogicalScreen::LogicalWidth, LogicalScreen::LogicalHeight), "OOPS! I MISSED", Style::Default);
+    LogicalScreen screen(window, "OOPS! I MISSED");
+    for (int i = 1; i < argc; i++)
     {
-        highScore = 0;  // Set high score to 0 if the file does not exist or can't be read
+        if (string(argv[i]) == "--fullscreen")
+        {
+            screen.toggleFullscreen();
+        }
+        else if (string(argv[i]) == "--render-scale" && i + 1 < argc)
+        {
+            screen.setFixedQuality((int)(atof(argv[++i]) * 10 + 0.5));
+        }
     }
 
-    RenderWindow window(VideoMode(900, 800), "OOPS! I MISSED", Style::Default);
+    // Everything comes from the mapped asset pack when there is one (see --pack), from loose files otherwise
+    long long loadStart = nanosecondsNow();
+    AssetPack pack;
+    pack.open("Assets.pack");
+
+    // Pack every sprite sheet and UI image the menu needs into one atlas texture
+    AssetManager assets;
+    assets.setPack(&pack);
+    addAtlasImages(assets);
+    addBitmapFonts(assets);
+    assets.buildAtlas();
+
+    // The rest is decoded on a worker thread once the menu is showing
+    AssetLoader gameAssets(&pack);
+    addGameAssets(gameAssets);
 
     // Background Image
-    Texture backgroundTexture;
     Sprite backgroundSprite;
-    backgroundTexture.loadFromFile("Textures/landscape.jpg");
-    backgroundSprite.setTexture(backgroundTexture);
+    assets.setAtlasSprite(backgroundSprite, "Textures/landscape.jpg");
     backgroundSprite.setColor(Color(255, 255, 255, 255 * 0.5));
 
     // Font
-    Font font1;
-    font1.loadFromFile("Fonts/Super Childish.ttf");
-    Font font2;
-    font2.loadFromFile("Fonts/Coffee Spark.ttf");
-
-    // Birds Sprite
-    WhiteBird white("Textures/flappy bird white.png", 5, 3, 0.1f); // 5 columns, 3 rows, 0.1 seconds per frame
-    BlueBird blue("Textures/flappy bird blue.png", 4, 2, 0.1f); // 4 columns, 2 rows, 0.1 seconds per frame
-    TurboBird turbo("Textures/turbo bird.png", 4, 1, 0.1f); // 4 columns, 1 rows, 0.1 seconds per frame
-    Bird monster("Textures/monster.png", 4, 1, 0.1f); // 4 columns, 1 rows, 0.1 seconds per frame
+    Font& font1 = *assets.getFont("Fonts/Super Childish.ttf");
+    Font& font2 = *assets.getFont("Fonts/Coffee Spark.ttf");
+    cout << "Assets ready in " << (nanosecondsNow() - loadStart) / 1000000 << " ms from " << (pack.isOpen() ? "Assets.pack" : "loose files") << endl;
+
+    // Bird types, and the waves they arrive in
+    vector<BirdType> birdTypes;
+    makeBirdTypes(birdTypes, assets);
+    vector<SpawnRule> waves;
+    loadWaveTable(waves);
+
+    Profiler profiler; // F3 shows frame statistics, F4 saves a trace
+    VoicePool voices; // Sound effect voices, on their own thread
+    voices.start();
+
+    GameContext context = { window, screen, assets, backgroundSprite, font1, font2, birdTypes, waves, leaderboard, score, highScore, streak, recordFile, profiler, gameAssets, voices };
+
+    // Every scene is built once, switching between them only moves a pointer on the stack
+    SceneManager scenes(window, screen, assets.getSolidRegion(), profiler);
+    ProfilerOverlay overlay(profiler, assets.getBitmapFont("Fonts/Super Childish.ttf", 16), assets.getAtlas());
+    scenes.setOverlay(overlay);
+    scenes.setPacer(pacer);
+    overlay.setPacer(pacer);
+    overlay.setScreen(screen);
+    MenuScene menuScene(context, scenes);
+    GuideScene guideScene(context, scenes);
+    GameScene gameScene(context, scenes);
+    GameOverScene gameOverScene(context);
+    scenes.registerScene(MenuSceneId, menuScene);
+    scenes.registerScene(GuideSceneId, guideScene);
+    scenes.registerScene(PlaySceneId, gameScene);
+    scenes.registerScene(GameOverSceneId, gameOverScene);
 
     // Calling Main Menu
-    mainMenu(window, backgroundSprite, font1, font2, white, blue, turbo, monster, ScoreFile, score, highScore, streak);
-    GameWindow(window, backgroundSprite, font1, font2, white, blue, turbo, monster, ScoreFile, score, highScore, streak);
+    scenes.run(MenuSceneId);
 
     return 0;
 }